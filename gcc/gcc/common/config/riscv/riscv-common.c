@@ -58,25 +58,23 @@ riscv_parse_arch_string (const char *isa, int *flags)
     *flags |= MASK_ATOMIC, p++;
 
   *flags |= MASK_SOFT_FLOAT_ABI;
+  *flags &= ~MASK_SINGLE_FLOAT;
   if (*p == 'F')
     *flags &= ~MASK_SOFT_FLOAT_ABI, p++;
 
   if (*p == 'D')
     {
       p++;
-      if (!TARGET_HARD_FLOAT)
+      if (*flags & MASK_SOFT_FLOAT_ABI)
 	{
 	  error ("-march=%s: the D extension requires the F extension", isa);
 	  return;
 	}
     }
-  else if (TARGET_HARD_FLOAT)
-    {
-	if (Pulp_DP_Format != PULP_DP_FORMAT32) {
-      		error ("-march=%s: single-precision-only is not yet supported", isa);
-      		return;
-	}
-    }
+  else if (!(*flags & MASK_SOFT_FLOAT_ABI) && Pulp_DP_Format != PULP_DP_FORMAT32)
+    /* F without D: float lives in FPRs, double is done in software
+       and passed in GPRs.  */
+    *flags |= MASK_SINGLE_FLOAT;
 
   *flags &= ~MASK_USE_16REG;
   if (*p == 'E')
@@ -42,6 +42,15 @@ enum riscv_code_model {
 };
 extern enum riscv_code_model riscv_cmodel;
 
+/* Event unit registers used by the native OpenMP lowering.  */
+enum riscv_evt_unit_reg {
+  EVT_UNIT_BARRIER,
+  EVT_UNIT_MUTEX,
+  EVT_UNIT_LOOP_START,
+  EVT_UNIT_LOOP_CHUNK,
+  EVT_UNIT_LAST
+};
+
 extern bool riscv_symbolic_constant_p (rtx, enum riscv_symbol_type *);
 extern int riscv_regno_mode_ok_for_base_p (int, enum machine_mode, bool);
 extern int riscv_address_insns (rtx, enum machine_mode, bool);
@@ -72,6 +81,9 @@ extern int  riscv_replicated_const_vector (rtx op, int min_val, int max_val);
 
 extern rtx  riscv_to_int_mode (rtx);
 extern void riscv_expand_vector_init(rtx target, rtx vals);
+extern void riscv_expand_dot_prod_pairs (rtx *operands, rtx (*gen) (rtx, rtx, rtx, rtx));
+extern void riscv_expand_vec_unpack (rtx op0, rtx op1, bool unsigned_p, bool high_p);
+extern void riscv_expand_vec_pack (rtx op0, rtx op1, rtx op2, int sat);
 
 extern int  riscv_valid_norm_round_imm_op(rtx norm_oper, rtx round_oper, int MaxVal);
 extern int  riscv_bit_size_for_clip (HOST_WIDE_INT i);
@@ -85,6 +97,10 @@ extern bool riscv_bitmask_ins_p (unsigned HOST_WIDE_INT, int, enum machine_mode)
 extern bool riscv_bottom_bitmask_p (unsigned HOST_WIDE_INT);
 
 extern bool riscv_valid_permute_operands(rtx op1, rtx op2, rtx sel);
+
+extern bool riscv_split_norm_round (rtx, rtx, rtx, enum rtx_code);
+extern void riscv_expand_fixed_arith (enum rtx_code, rtx *, bool);
+extern void riscv_expand_fixed_convert (rtx, rtx, bool);
 #endif
 
 extern void riscv_hardware_loop (void);
@@ -93,6 +109,7 @@ extern rtx riscv_expand_call (bool, rtx, rtx, rtx);
 extern void riscv_expand_fcc_reload (rtx, rtx, rtx);
 extern void riscv_set_return_address (rtx, rtx);
 extern bool riscv_expand_block_move (rtx, rtx, rtx);
+extern bool riscv_expand_block_set (rtx, rtx, rtx);
 extern void riscv_expand_synci_loop (rtx, rtx);
 
 extern bool riscv_expand_ext_as_unaligned_load (rtx, rtx, HOST_WIDE_INT,
@@ -125,6 +142,9 @@ extern bool riscv_filter_pulp_operand(rtx, bool);
 
 extern bool riscv_is_tiny_symbol_p (rtx addr);
 
+extern rtx riscv_evt_unit_base (rtx);
+extern int riscv_evt_unit_offset (enum riscv_evt_unit_reg);
+
 extern void riscv_output_external (FILE *file, tree decl, const char *name);
 
 
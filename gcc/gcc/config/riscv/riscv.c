@@ -81,8 +81,11 @@ along with GCC; see the file COPYING3.  If not see
 #include "lcm.h"
 #include "cfgbuild.h"
 #include "cfgcleanup.h"
+#include "cfgloop.h"
+#include "tree-vectorizer.h"
 #include "predict.h"
 #include "basic-block.h"
+#include "df.h"
 #include "sched-int.h"
 #include "tree-ssa-alias.h"
 #include "internal-fn.h"
@@ -91,6 +94,10 @@ along with GCC; see the file COPYING3.  If not see
 #include "gimple-expr.h"
 #include "is-a.h"
 #include "gimple.h"
+#include "gimple-iterator.h"
+#include "gimple-ssa.h"
+#include "tree-ssanames.h"
+#include "ssa-iterators.h"
 #include "gimplify.h"
 #include "bitmap.h"
 #include "diagnostic.h"
@@ -168,6 +175,8 @@ enum riscv_code_model riscv_cmodel = TARGET_DEFAULT_CMODEL;
 
 /* for builtin pulpv2, we model vectors as opaque entities. Opaque helps to make the call style mode versatile */
 static tree opaque_V4QI_type_node;
+static tree riscv_fp16_type_node;
+static tree riscv_fp8_type_node;
 static tree opaque_V2HI_type_node;
 
 /* Macros to create an enumeration identifier for a function prototype.  */
@@ -225,6 +234,11 @@ struct GTY(())  riscv_frame_info {
   /* The offset of arg_pointer_rtx from the bottom of the frame.  */
   HOST_WIDE_INT arg_pointer_offset;
   unsigned int is_it;
+
+  /* Hardware loop levels whose LS/LE/LC registers an interrupt handler
+     saves, and the offset of their save area from frame bottom.  */
+  unsigned int hwloop_levels;
+  HOST_WIDE_INT hwloop_sp_offset;
 };
 
 struct GTY(())  machine_function {
@@ -243,6 +257,8 @@ struct GTY(())  machine_function {
   unsigned int is_pure_interrupt;
   int contains_call;
 
+  /* Pseudo holding the event unit base, set up once at function entry.  */
+  rtx evt_unit_base;
 };
 
 /* Information about a single argument.  */
@@ -313,6 +329,24 @@ struct riscv_integer_op {
    but we may attempt and reject even worse sequences.  */
 #define RISCV_MAX_INTEGER_OPS 32
 
+/* Costs of the vectorizer statement kinds on V2HI/V4QI, in units of a
+   scalar statement. Entries indexed by [2] are {V2HI, V4QI}.  */
+
+struct riscv_vector_cost
+{
+  unsigned short stmt;			/* pv.add, pv.dotsp... */
+  unsigned short load;
+  unsigned short store;
+  unsigned short unaligned_load;
+  unsigned short unaligned_store;
+  unsigned short perm[2];		/* vec_perm<mode> */
+  unsigned short promote_demote[2];	/* vec_pack/vec_unpack */
+  unsigned short lane_insert;		/* pv.insert or pv.add.sc, per lane */
+  unsigned short lane_extract;		/* pv.extract, per lane */
+  unsigned short cond_taken_branch;
+  unsigned short cond_not_taken_branch;
+};
+
 /* Costs of various operations on the different architectures.  */
 
 struct riscv_tune_info
@@ -326,6 +360,10 @@ struct riscv_tune_info
   unsigned short branch_cost;
   unsigned short fp_to_int_cost;
   unsigned short memory_cost;
+  const struct riscv_vector_cost *vec_costs;
+  /* Largest word aligned block copied or set with an inline loop,
+     bigger ones call memcpy/memset.  */
+  unsigned short block_inline_max;
 };
 
 /* Information about one CPU we know about.  */
@@ -338,6 +376,9 @@ struct riscv_cpu_info {
 
   /* Tuning parameters for this CPU.  */
   const struct riscv_tune_info *tune_info;
+
+  /* Pipeline description used by the scheduler.  */
+  enum riscv_microarchitecture_type microarchitecture;
 };
 
 /* Global variables for machine-dependent things.  */
@@ -345,6 +386,9 @@ struct riscv_cpu_info {
 /* Which tuning parameters to use.  */
 static const struct riscv_tune_info *tune_info;
 
+/* Which pipeline description to use.  */
+enum riscv_microarchitecture_type riscv_microarchitecture;
+
 /* Index [M][R] is true if register R is allowed to hold a value of mode M.  */
 bool riscv_hard_regno_mode_ok[(int) MAX_MACHINE_MODE][FIRST_PSEUDO_REGISTER];
 
@@ -379,7 +423,55 @@ const enum reg_class riscv_regno_to_class[FIRST_PSEUDO_REGISTER] = {
   VIT_REGS
 };
 
-/* Costs to use when optimizing for size.  */
+/* Cores without the pv.* instructions: vectors live in a GPR and every
+   lane operation is a sequence of shifts and masks.  */
+static const struct riscv_vector_cost generic_vector_cost = {
+  1,						/* stmt */
+  1,						/* load */
+  1,						/* store */
+  4,						/* unaligned_load */
+  4,						/* unaligned_store */
+  {4, 8},					/* perm */
+  {4, 8},					/* promote_demote */
+  3,						/* lane_insert */
+  2,						/* lane_extract */
+  3,						/* cond_taken_branch */
+  1						/* cond_not_taken_branch */
+};
+
+/* RI5CY: a misaligned word access takes a second memory cycle, a two
+   operand vec_perm needs its selector in a register (lui/addi) and the
+   result tied to the first input, see vec_perm<mode> in riscv.md. A
+   V4QI pack is a pv.packlo.b/pv.packhi.b pair.  */
+static const struct riscv_vector_cost riscy_vector_cost = {
+  1,						/* stmt */
+  1,						/* load */
+  1,						/* store */
+  2,						/* unaligned_load */
+  2,						/* unaligned_store */
+  {2, 3},					/* perm */
+  {1, 2},					/* promote_demote */
+  1,						/* lane_insert */
+  1,						/* lane_extract */
+  2,						/* cond_taken_branch */
+  1						/* cond_not_taken_branch */
+};
+
+/* Instruction counts when optimizing for size.  */
+static const struct riscv_vector_cost size_vector_cost = {
+  1,						/* stmt */
+  1,						/* load */
+  1,						/* store */
+  1,						/* unaligned_load */
+  1,						/* unaligned_store */
+  {3, 3},					/* perm */
+  {1, 2},					/* promote_demote */
+  1,						/* lane_insert */
+  1,						/* lane_extract */
+  1,						/* cond_taken_branch */
+  1						/* cond_not_taken_branch */
+};
+
 static const struct riscv_tune_info rocket_tune_info = {
   {COSTS_N_INSNS (4), COSTS_N_INSNS (5)},	/* fp_add */
   {COSTS_N_INSNS (4), COSTS_N_INSNS (5)},	/* fp_mul */
@@ -389,7 +481,71 @@ static const struct riscv_tune_info rocket_tune_info = {
   1,						/* issue_rate */
   3,						/* branch_cost */
   COSTS_N_INSNS (2),				/* fp_to_int_cost */
-  5						/* memory_cost */
+  5,						/* memory_cost */
+  &generic_vector_cost,				/* vec_costs */
+  1024						/* block_inline_max */
+};
+
+/* RI5CY, 4 stage in-order pipeline with single cycle mul/mac, a 1 cycle
+   load-use stall, a serial divider and a (possibly shared) FPU.  */
+static const struct riscv_tune_info riscy_tune_info = {
+  {COSTS_N_INSNS (3), COSTS_N_INSNS (20)},	/* fp_add */
+  {COSTS_N_INSNS (3), COSTS_N_INSNS (20)},	/* fp_mul */
+  {COSTS_N_INSNS (11), COSTS_N_INSNS (60)},	/* fp_div */
+  {COSTS_N_INSNS (1), COSTS_N_INSNS (4)},	/* int_mul */
+  {COSTS_N_INSNS (35), COSTS_N_INSNS (70)},	/* int_div */
+  1,						/* issue_rate */
+  2,						/* branch_cost */
+  COSTS_N_INSNS (1),				/* fp_to_int_cost */
+  4,						/* memory_cost */
+  &riscy_vector_cost,				/* vec_costs */
+  1024						/* block_inline_max */
+};
+
+/* Pulp slim, RI5CY without FPU and without the PULP DSP extensions.  */
+static const struct riscv_tune_info pulpslim_tune_info = {
+  {COSTS_N_INSNS (4), COSTS_N_INSNS (5)},	/* fp_add */
+  {COSTS_N_INSNS (4), COSTS_N_INSNS (5)},	/* fp_mul */
+  {COSTS_N_INSNS (20), COSTS_N_INSNS (20)},	/* fp_div */
+  {COSTS_N_INSNS (1), COSTS_N_INSNS (4)},	/* int_mul */
+  {COSTS_N_INSNS (35), COSTS_N_INSNS (70)},	/* int_div */
+  1,						/* issue_rate */
+  2,						/* branch_cost */
+  COSTS_N_INSNS (2),				/* fp_to_int_cost */
+  4,						/* memory_cost */
+  &generic_vector_cost,				/* vec_costs */
+  256						/* block_inline_max */
+};
+
+/* Zero-riscy, 2 stage pipeline stalling on loads and stores, 3 cycle
+   multiplier and serial divider. No FPU, fp costs are the rocket ones.  */
+static const struct riscv_tune_info zeroriscy_tune_info = {
+  {COSTS_N_INSNS (4), COSTS_N_INSNS (5)},	/* fp_add */
+  {COSTS_N_INSNS (4), COSTS_N_INSNS (5)},	/* fp_mul */
+  {COSTS_N_INSNS (20), COSTS_N_INSNS (20)},	/* fp_div */
+  {COSTS_N_INSNS (3), COSTS_N_INSNS (12)},	/* int_mul */
+  {COSTS_N_INSNS (37), COSTS_N_INSNS (74)},	/* int_div */
+  1,						/* issue_rate */
+  2,						/* branch_cost */
+  COSTS_N_INSNS (2),				/* fp_to_int_cost */
+  4,						/* memory_cost */
+  &generic_vector_cost,				/* vec_costs */
+  256						/* block_inline_max */
+};
+
+/* Micro-riscy, zero-riscy with 16 registers and a bit serial multiplier.  */
+static const struct riscv_tune_info microriscy_tune_info = {
+  {COSTS_N_INSNS (4), COSTS_N_INSNS (5)},	/* fp_add */
+  {COSTS_N_INSNS (4), COSTS_N_INSNS (5)},	/* fp_mul */
+  {COSTS_N_INSNS (20), COSTS_N_INSNS (20)},	/* fp_div */
+  {COSTS_N_INSNS (34), COSTS_N_INSNS (136)},	/* int_mul */
+  {COSTS_N_INSNS (37), COSTS_N_INSNS (74)},	/* int_div */
+  1,						/* issue_rate */
+  2,						/* branch_cost */
+  COSTS_N_INSNS (2),				/* fp_to_int_cost */
+  4,						/* memory_cost */
+  &generic_vector_cost,				/* vec_costs */
+  128						/* block_inline_max */
 };
 
 /* Costs to use when optimizing for size.  */
@@ -402,16 +558,30 @@ static const struct riscv_tune_info optimize_size_tune_info = {
   1,						/* issue_rate */
   1,						/* branch_cost */
   COSTS_N_INSNS (1),				/* fp_to_int_cost */
-  1						/* memory_cost */
+  1,						/* memory_cost */
+  &size_vector_cost,				/* vec_costs */
+  0						/* block_inline_max */
 };
 
 /* A table describing all the processors GCC knows about.  */
 static const struct riscv_cpu_info riscv_cpu_info_table[] = {
   /* Entries for generic ISAs.  */
-  { "rocket", "IMAFD", &rocket_tune_info },
+  { "rocket", "IMAFD", &rocket_tune_info, generic_rocket },
+
+  /* PULP cores.  */
+  { "riscy", "IMFCXpulpv2", &riscy_tune_info, pulp_riscy },
+  { "zeroriscy", "IMC", &zeroriscy_tune_info, pulp_zeroriscy },
+  { "microriscy", "IEC", &microriscy_tune_info, pulp_microriscy },
+  { "pulpslim", "IMCXpulpslim", &pulpslim_tune_info, pulp_pulpslim },
 };
 
 static unsigned int MaxArgInReg = MAX_ARGS_IN_REGISTERS;
+static void riscv_register_hwloop_info_pass (void);
+static unsigned riscv_interrupt_hwloop_levels (void);
+static void riscv_register_dot_prod_pass (void);
+static void riscv_register_postmod_reg_pass (void);
+static bool riscv_small_float_mode_p (enum machine_mode);
+static tree riscv_omp_target_decl (int, int *, int *);
 /* Return the riscv_cpu_info entry for the given name string.  */
 
 static const struct riscv_cpu_info *
@@ -1482,6 +1652,16 @@ riscv_legitimize_const_move (enum machine_mode mode, rtx dest, rtx src)
 bool
 riscv_legitimize_move (enum machine_mode mode, rtx dest, rtx src)
 {
+  /* Fixed-point constants are loaded as their integer bit pattern.  */
+  if (CONST_FIXED_P (src))
+    {
+      enum machine_mode imode = int_mode_for_mode (mode);
+
+      emit_move_insn (gen_lowpart (imode, dest),
+		      simplify_gen_subreg (imode, src, mode, 0));
+      return true;
+    }
+
   if (!register_operand (dest, mode) && !reg_or_0_operand (src, mode))
     {
       riscv_emit_move (dest, force_reg (mode, src));
@@ -1535,6 +1715,13 @@ riscv_immediate_operand_p (int code, HOST_WIDE_INT x)
       /* We can emulate an immediate of 1 by using GT/GTU against x0. */
       return x == 1;
 
+    case EQ:
+    case NE:
+      /* Xpulpv2 has p.beqimm/p.bneimm with a 5-bit signed immediate.  */
+      if (Pulp_Cpu>=PULP_V2)
+	return x >= -16 && x <= 15;
+      return x == 0;
+
     default:
       /* By default assume that x0 can be used for 0.  */
       return x == 0;
@@ -1591,6 +1778,304 @@ riscv_zero_extend_cost (enum machine_mode mode, rtx op)
   return COSTS_N_INSNS (1);
 }
 
+/* Return the cost of a PULP multiplier instruction (p.mac, p.mulsRN, dot
+   products...), not including the cost of its operands.  */
+
+static int
+riscv_pulp_mul_cost (bool speed)
+{
+  return speed ? tune_info->int_mul[0] : COSTS_N_INSNS (1);
+}
+
+/* Return X with a sign or zero extension stripped.  Set *PARTIAL if an
+   extension from a half word, or the selection of the upper half word
+   of a register (p.mulhhs, p.machhs...), was found.  */
+
+static rtx
+riscv_pulp_strip_extend (rtx x, bool *partial)
+{
+  if ((GET_CODE (x) == SIGN_EXTEND || GET_CODE (x) == ZERO_EXTEND)
+      && GET_MODE (XEXP (x, 0)) == HImode)
+    {
+      *partial = true;
+      return XEXP (x, 0);
+    }
+  if ((GET_CODE (x) == ASHIFTRT || GET_CODE (x) == LSHIFTRT)
+      && GET_MODE (x) == SImode
+      && CONST_INT_P (XEXP (x, 1)) && INTVAL (XEXP (x, 1)) == 16)
+    {
+      *partial = true;
+      return XEXP (x, 0);
+    }
+  return x;
+}
+
+/* If X is a multiplication that p.mac or one of the partial p.macs/p.macu
+   forms can absorb, return the sum of the costs of its factors in *COST
+   and return true.  */
+
+static bool
+riscv_pulp_mac_mult_p (rtx x, int *cost, bool speed)
+{
+  rtx op0, op1;
+  bool partial0 = false, partial1 = false;
+
+  if (GET_CODE (x) != MULT || GET_MODE (x) != SImode)
+    return false;
+
+  op0 = riscv_pulp_strip_extend (XEXP (x, 0), &partial0);
+  op1 = riscv_pulp_strip_extend (XEXP (x, 1), &partial1);
+  if (partial0 != partial1)
+    return false;
+  if (partial0 ? TARGET_MASK_NOPARTMAC : TARGET_MASK_NOMAC)
+    return false;
+
+  *cost = set_src_cost (op0, speed) + set_src_cost (op1, speed);
+  return true;
+}
+
+/* Return the source operand of a p.insert bit field insertion made of
+   (ior KEEP INS), as matched by the insvsi patterns of riscv.md, or NULL_RTX
+   if KEEP and INS do not form one.  */
+
+static rtx
+riscv_pulp_bit_insert_source (rtx keep, rtx ins)
+{
+  HOST_WIDE_INT mask;
+
+  if (GET_CODE (keep) != AND || !CONST_INT_P (XEXP (keep, 1)))
+    return NULL_RTX;
+  mask = INTVAL (XEXP (keep, 1));
+
+  if (GET_CODE (ins) == ASHIFT && CONST_INT_P (XEXP (ins, 1)))
+    return riscv_bitmask_ins_p (mask, INTVAL (XEXP (ins, 1)), SImode) ? XEXP (ins, 0) : NULL_RTX;
+
+  if (GET_CODE (ins) != AND || !CONST_INT_P (XEXP (ins, 1)) || INTVAL (XEXP (ins, 1)) != ~mask)
+    return NULL_RTX;
+
+  if (GET_CODE (XEXP (ins, 0)) == ASHIFT && CONST_INT_P (XEXP (XEXP (ins, 0), 1)))
+    {
+      if (riscv_bitmask (INTVAL (XEXP (ins, 1)), NULL, VOIDmode) == INTVAL (XEXP (XEXP (ins, 0), 1)))
+	return XEXP (XEXP (ins, 0), 0);
+      return NULL_RTX;
+    }
+  if (riscv_bottom_bitmask_p (INTVAL (XEXP (ins, 1))) || riscv_bottom_bitmask_p (mask))
+    return XEXP (ins, 0);
+  return NULL_RTX;
+}
+
+/* Cost the Xpulp forms of riscv.md. Without them combine rejects p.mac,
+   p.clip, p.insert... as being more expensive than the instruction
+   sequences they replace. Return true if X, of code CODE, is one of these
+   forms and store its cost in *TOTAL. *DONE is set to the value
+   riscv_rtx_costs has to return: true when the cost of the operands has
+   already been added.  */
+
+static bool
+riscv_pulp_rtx_costs (rtx x, int code, int *total, bool *done, bool speed)
+{
+  enum machine_mode mode = GET_MODE (x);
+  rtx op0, op1, inner, round, acc, src;
+  bool partial = false;
+  int cost;
+
+  *done = false;
+  if (Pulp_Cpu < PULP_V0)
+    return false;
+
+  /* Vector ops on V2HI/V4QI are single instructions.  */
+  if (mode == V2HImode || mode == V4QImode)
+    {
+      if (Pulp_Cpu < PULP_V2 || TARGET_MASK_NOVECT)
+	return false;
+      switch (code)
+	{
+	case PLUS: case MINUS: case SMIN: case SMAX: case UMIN: case UMAX:
+	case AND: case IOR: case XOR: case NEG: case ABS:
+	case ASHIFT: case ASHIFTRT: case LSHIFTRT:
+	case VEC_DUPLICATE: case VEC_CONCAT: case VEC_MERGE: case VEC_SELECT:
+	  *total = COSTS_N_INSNS (1);
+	  return true;
+	default:
+	  return false;
+	}
+    }
+
+  /* The scalar Xpulp patterns are all SImode: DImode min/max/abs on rv32
+     and the float ones keep the default costs.  */
+  if (mode != SImode)
+    return false;
+
+  switch (code)
+    {
+    case PLUS:
+      op0 = XEXP (x, 0);
+      op1 = XEXP (x, 1);
+      /* p.mac, p.macs, p.macu: (plus (mult a b) c).  */
+      acc = NULL_RTX;
+      if (riscv_pulp_mac_mult_p (op0, &cost, speed))
+	acc = op1;
+      else if (riscv_pulp_mac_mult_p (op1, &cost, speed))
+	acc = op0;
+      if (acc)
+	{
+	  *total = riscv_pulp_mul_cost (speed) + cost + set_src_cost (acc, speed);
+	  *done = true;
+	  return true;
+	}
+      /* pv.dotsp, pv.dotup: the sum of two products of vector elements.  */
+      if (GET_CODE (op0) == MULT && GET_CODE (op1) == MULT
+	  && Pulp_Cpu >= PULP_V2 && !TARGET_MASK_NOVECT)
+	{
+	  inner = XEXP (op0, 0);
+	  if (GET_CODE (inner) == SIGN_EXTEND || GET_CODE (inner) == ZERO_EXTEND)
+	    inner = XEXP (inner, 0);
+	  if (GET_CODE (inner) == VEC_SELECT)
+	    {
+	      *total = riscv_pulp_mul_cost (speed) + set_src_cost (XEXP (inner, 0), speed);
+	      *done = true;
+	      return true;
+	    }
+	}
+      return false;
+
+    case MINUS:
+      /* p.msu: (minus c (mult a b)).  */
+      op1 = XEXP (x, 1);
+      if (Pulp_Cpu >= PULP_V2 && !TARGET_MASK_NOMAC && GET_CODE (op1) == MULT
+	  && GET_CODE (XEXP (op1, 0)) != SIGN_EXTEND && GET_CODE (XEXP (op1, 0)) != ZERO_EXTEND)
+	{
+	  *total = riscv_pulp_mul_cost (speed) + set_src_cost (XEXP (x, 0), speed)
+		   + set_src_cost (XEXP (op1, 0), speed) + set_src_cost (XEXP (op1, 1), speed);
+	  *done = true;
+	  return true;
+	}
+      return false;
+
+    case ASHIFTRT:
+    case LSHIFTRT:
+      op1 = XEXP (x, 1);
+      if (Pulp_Cpu < PULP_V2 || !CONST_INT_P (op1))
+	return false;
+      /* Peel the rounding constant, then the accumulator.  */
+      inner = XEXP (x, 0);
+      round = acc = NULL_RTX;
+      if (GET_CODE (inner) == PLUS && CONST_INT_P (XEXP (inner, 1)))
+	{
+	  round = XEXP (inner, 1);
+	  inner = XEXP (inner, 0);
+	}
+      if (GET_CODE (inner) == PLUS && GET_CODE (XEXP (inner, 0)) == MULT)
+	{
+	  acc = XEXP (inner, 1);
+	  inner = XEXP (inner, 0);
+	}
+      if (GET_CODE (inner) == MULT)
+	{
+	  /* p.mulsN, p.mulsRN, p.macsN, p.macsRN and their unsigned and
+	     high half variants, all 16x16 products.  */
+	  if (TARGET_MASK_NOMULMACNORMROUND
+	      || !riscv_valid_norm_round_imm_op (op1, round, 31))
+	    return false;
+	  op0 = riscv_pulp_strip_extend (XEXP (inner, 0), &partial);
+	  if (!partial)
+	    return false;
+	  *total = riscv_pulp_mul_cost (speed) + set_src_cost (op0, speed)
+		   + set_src_cost (riscv_pulp_strip_extend (XEXP (inner, 1), &partial), speed);
+	  if (acc)
+	    *total += set_src_cost (acc, speed);
+	  *done = true;
+	  return true;
+	}
+      /* p.addN, p.addRN, p.subN, p.subRN.  */
+      if ((GET_CODE (inner) == PLUS || GET_CODE (inner) == MINUS) && !acc
+	  && !TARGET_MASK_NOADDSUBNORMROUND
+	  && riscv_valid_norm_round_imm_op (op1, round, 31))
+	{
+	  *total = COSTS_N_INSNS (1) + set_src_cost (XEXP (inner, 0), speed)
+		   + set_src_cost (XEXP (inner, 1), speed);
+	  *done = true;
+	  return true;
+	}
+      return false;
+
+    case SMIN:
+    case SMAX:
+      /* p.clip: (smax (smin x 2^n-1) -2^n) or (smin (smax x -2^n) 2^n-1).  */
+      op0 = XEXP (x, 0);
+      op1 = XEXP (x, 1);
+      if (Pulp_Cpu >= PULP_V2 && !TARGET_MASK_NOCLIP
+	  && GET_CODE (op0) == (code == SMIN ? SMAX : SMIN)
+	  && CONST_INT_P (op1) && CONST_INT_P (XEXP (op0, 1))
+	  && riscv_valid_clip_operands (code == SMIN ? op1 : XEXP (op0, 1),
+					code == SMIN ? XEXP (op0, 1) : op1, 1))
+	{
+	  *total = COSTS_N_INSNS (1) + set_src_cost (XEXP (op0, 0), speed);
+	  *done = true;
+	  return true;
+	}
+      /* Fall through.  */
+
+    case UMIN:
+    case UMAX:
+      /* p.min, p.max, p.minu, p.maxu.  */
+      if (TARGET_MASK_NOMINMAX)
+	return false;
+      *total = COSTS_N_INSNS (1);
+      return true;
+
+    case ABS:
+      /* p.abs.  */
+      if (TARGET_MASK_NOABS)
+	return false;
+      *total = COSTS_N_INSNS (1);
+      return true;
+
+    case SIGN_EXTRACT:
+    case ZERO_EXTRACT:
+      /* p.extract, p.extractu.  */
+      if (Pulp_Cpu < PULP_V2 || TARGET_MASK_NOBITOP)
+	return false;
+      *total = COSTS_N_INSNS (1) + set_src_cost (XEXP (x, 0), speed);
+      *done = true;
+      return true;
+
+    case AND:
+    case IOR:
+      if (Pulp_Cpu < PULP_V2 || TARGET_MASK_NOBITOP)
+	return false;
+      op0 = XEXP (x, 0);
+      op1 = XEXP (x, 1);
+      /* p.bclr, p.bset: the mask is encoded in the instruction.  */
+      if (CONST_INT_P (op1)
+	  && riscv_valid_bit_field_imm_operand (op1, NULL, code == IOR, NULL, NULL))
+	{
+	  *total = COSTS_N_INSNS (1) + set_src_cost (op0, speed);
+	  *done = true;
+	  return true;
+	}
+      if (code == AND)
+	return false;
+      /* p.insert.  */
+      if ((src = riscv_pulp_bit_insert_source (op0, op1)) == NULL_RTX)
+	{
+	  src = riscv_pulp_bit_insert_source (op1, op0);
+	  op0 = op1;
+	}
+      if (src)
+	{
+	  *total = COSTS_N_INSNS (1) + set_src_cost (XEXP (op0, 0), speed)
+		   + set_src_cost (src, speed);
+	  *done = true;
+	  return true;
+	}
+      return false;
+
+    default:
+      return false;
+    }
+}
+
 /* Implement TARGET_RTX_COSTS.  */
 
 static bool
@@ -1599,8 +2084,12 @@ riscv_rtx_costs (rtx x, int code, int outer_code, int opno ATTRIBUTE_UNUSED,
 {
   enum machine_mode mode = GET_MODE (x);
   bool float_mode_p = FLOAT_MODE_P (mode);
+  bool done;
   int cost;
 
+  if (riscv_pulp_rtx_costs (x, code, total, &done, speed))
+    return done;
+
   switch (code)
     {
     case CONST_INT:
@@ -1810,12 +2299,29 @@ riscv_address_cost (rtx addr, enum machine_mode mode,
        		else if (addr_info.type == ADDRESS_REG_POST_INC || addr_info.type == ADDRESS_REG_POST_DEC ||
 			 addr_info.type == ADDRESS_REG_POST_MODIFY) n--;
 
-	} else {
+	} else if (!TARGET_MASK_IVPOSTMOD) {
        		/* Even more discouraged *reg(reg) since this pattern decrease induction attractiviry */
 		if (GET_CODE(addr) == PLUS) {
                         if (GET_CODE (XEXP (addr, 0)) == REG && GET_CODE (XEXP (addr, 1)) == REG) return 16;
                         else return 12;
                 } else return 0;
+	} else {
+		/* Cost model aimed at ivopts. A post modified access absorbs the pointer update and
+		   ivopts then drops the step of its candidate, make it the cheapest form. *reg(reg) keeps
+		   an index IV alive whose add is pure overhead once lp.setup holds the trip count in a
+		   hw loop counter, charge it for that add.  */
+       		riscv_classify_address (&addr_info, addr, mode, false);
+		switch (addr_info.type) {
+			case ADDRESS_REG_POST_INC:
+			case ADDRESS_REG_POST_DEC:
+			case ADDRESS_REG_POST_MODIFY:
+				return 0;
+			case ADDRESS_REG_REG:
+				if ((Pulp_Cpu>=PULP_V1) && !TARGET_MASK_NOHWLOOP) return COSTS_N_INSNS (1) + 1;
+				return COSTS_N_INSNS (1);
+			default:
+				return 1;
+		}
 	}
 
     }
@@ -1824,6 +2330,153 @@ riscv_address_cost (rtx addr, enum machine_mode mode,
   return 0;
 }
 
+/* Register stride post-modify.  auto-inc-dec only pairs a memory access
+   with an increment of its base in the same basic block, so a pointer
+   walked with a loop-invariant register stride (e.g. a row pitch) whose
+   add sits in the loop latch keeps a separate add.  Fold such adds into
+   p.lX/p.sX rd,rs2(rs1!) as well.  */
+
+/* Return the MEM of INSN if its address is a plain base register.  */
+
+static rtx
+riscv_postmod_reg_mem (rtx_insn *insn)
+
+{
+	rtx set = single_set (insn);
+	rtx mem, other;
+
+	if (!set) return NULL_RTX;
+	if (MEM_P (SET_DEST (set))) {
+		mem = SET_DEST (set); other = SET_SRC (set);
+	} else {
+		mem = SET_SRC (set); other = SET_DEST (set);
+		if (GET_CODE (mem) == ZERO_EXTEND || GET_CODE (mem) == SIGN_EXTEND) mem = XEXP (mem, 0);
+	}
+	if (!MEM_P (mem) || MEM_VOLATILE_P (mem) || !REG_P (XEXP (mem, 0))) return NULL_RTX;
+	/* p.sw p,r(p!) and p.lw p,r(p!) are not what the source meant.  */
+	if (reg_overlap_mentioned_p (XEXP (mem, 0), other)) return NULL_RTX;
+	return mem;
+}
+
+/* Return true if INSN is BASE = BASE + STRIDE with STRIDE a register.  */
+
+static bool
+riscv_postmod_reg_add_p (rtx_insn *insn, rtx base, rtx *stride)
+
+{
+	rtx set = single_set (insn);
+	rtx src;
+
+	if (!set || !rtx_equal_p (SET_DEST (set), base) || GET_CODE (SET_SRC (set)) != PLUS) return false;
+	src = SET_SRC (set);
+	if (rtx_equal_p (XEXP (src, 0), base)) *stride = XEXP (src, 1);
+	else if (rtx_equal_p (XEXP (src, 1), base)) *stride = XEXP (src, 0);
+	else return false;
+	return REG_P (*stride) && !rtx_equal_p (*stride, base);
+}
+
+/* Look for the increment of the base of MEM, the memory access of INSN,
+   in the rest of its block and, when BASE is dead on every other exit, in
+   a fallthrough successor that has no other predecessor.  */
+
+static rtx_insn *
+riscv_postmod_reg_find_add (rtx_insn *insn, rtx mem, rtx *stride)
+
+{
+	basic_block bb = BLOCK_FOR_INSN (insn);
+	rtx base = XEXP (mem, 0);
+	rtx_insn *cur = insn;
+	edge e, next = NULL;
+	edge_iterator ei;
+
+	while (true) {
+		for (cur = NEXT_INSN (cur); cur && cur != NEXT_INSN (BB_END (bb)); cur = NEXT_INSN (cur)) {
+			if (!NONDEBUG_INSN_P (cur)) continue;
+			if (riscv_postmod_reg_add_p (cur, base, stride))
+				return (reg_set_p (*stride, insn) || reg_set_between_p (*stride, insn, cur)) ? NULL : cur;
+			if (CALL_P (cur) || reg_overlap_mentioned_p (base, PATTERN (cur))
+			    || (REG_NOTES (cur) && reg_overlap_mentioned_p (base, REG_NOTES (cur)))) return NULL;
+		}
+		if (next || bb != BLOCK_FOR_INSN (insn)) return NULL;
+		FOR_EACH_EDGE (e, ei, bb->succs) {
+			if ((e->flags & EDGE_FALLTHRU) && single_pred_p (e->dest) && !(e->flags & EDGE_COMPLEX)) next = e;
+			else if (REGNO_REG_SET_P (df_get_live_in (e->dest), REGNO (base))) return NULL;
+		}
+		if (!next || next->dest == EXIT_BLOCK_PTR_FOR_FN (cfun)) return NULL;
+		bb = next->dest;
+		cur = PREV_INSN (BB_HEAD (bb));
+	}
+}
+
+static unsigned int
+riscv_postmod_reg (function *fun)
+
+{
+	basic_block bb;
+	rtx_insn *insn, *add;
+	rtx mem, stride, addr;
+	int count = 0;
+
+	df_analyze ();
+	FOR_EACH_BB_FN (bb, fun) {
+		FOR_BB_INSNS (bb, insn) {
+			if (!NONDEBUG_INSN_P (insn) || !(mem = riscv_postmod_reg_mem (insn))) continue;
+			if (!(add = riscv_postmod_reg_find_add (insn, mem, &stride))) continue;
+			addr = gen_rtx_POST_MODIFY (Pmode, XEXP (mem, 0), gen_rtx_PLUS (Pmode, XEXP (mem, 0), stride));
+			if (!validate_change (insn, &XEXP (mem, 0), addr, false)) continue;
+			remove_reg_equal_equiv_notes (insn);
+			add_reg_note (insn, REG_INC, XEXP (addr, 0));
+			df_insn_rescan (insn);
+			delete_insn (add);
+			count++;
+		}
+	}
+	if (dump_file && count)
+		fprintf (dump_file, "%d register post-modify formed\n", count);
+	return 0;
+}
+
+namespace {
+
+const pass_data pass_data_riscv_postmod_reg =
+{
+  RTL_PASS, /* type */
+  "postmodreg", /* name */
+  OPTGROUP_NONE, /* optinfo_flags */
+  TV_AUTO_INC_DEC, /* tv_id */
+  0, /* properties_required */
+  0, /* properties_provided */
+  0, /* properties_destroyed */
+  0, /* todo_flags_start */
+  TODO_df_finish, /* todo_flags_finish */
+};
+
+class pass_riscv_postmod_reg : public rtl_opt_pass
+{
+public:
+  pass_riscv_postmod_reg (gcc::context *ctxt)
+    : rtl_opt_pass (pass_data_riscv_postmod_reg, ctxt)
+  {}
+
+  virtual bool gate (function *)
+  {
+    return optimize > 0 && flag_auto_inc_dec && HAVE_POST_MODIFY_REG;
+  }
+  virtual unsigned int execute (function *fun) { return riscv_postmod_reg (fun); }
+};
+
+} // anon namespace
+
+/* Run right after auto-inc-dec, which handles the single block cases.  */
+static void
+riscv_register_postmod_reg_pass (void)
+{
+  opt_pass *pass_postmod_reg = new pass_riscv_postmod_reg (g);
+  struct register_pass_info postmod_reg = { pass_postmod_reg, "auto_inc_dec", 1, PASS_POS_INSERT_AFTER };
+
+  register_pass (&postmod_reg);
+}
+
 /* Return one word of double-word value OP.  HIGH_P is true to select the
    high part or false to select the low part. */
 
@@ -1970,7 +2623,7 @@ printf("----------------------------\n");
        }
 
       if (src_code == CONST_INT) return "li\t%0,%1";
-      else if (src_code == CONST_VECTOR) {
+      else if (src_code == CONST_VECTOR && GET_MODE_CLASS (GET_MODE (src)) == MODE_VECTOR_INT) {
 		if (((Pulp_Cpu>=PULP_V2) && !TARGET_MASK_NOVECT) && riscv_replicated_const_vector(src, -32, 31)) {
 			if (GET_MODE(src)==V4QImode) return "pv.add.sci.b\t%0,x0,%W1";
 			else return "pv.add.sci.h\t%0,x0,%w1";
@@ -2248,10 +2901,8 @@ riscv_emit_compare (enum rtx_code *code, rtx *op0, rtx *op1)
 
 	    case EQ:
 	    case NE:
-              if ((Pulp_Cpu>=PULP_V2) && (*code == EQ || *code == NE) && (GET_CODE(*op1) == CONST_INT) &&
-	          (INTVAL(*op1) >= -16) && (INTVAL(*op1) <= 15)) {
-              } else if (SMALL_OPERAND (-rhs))
 	      /* Convert e.g. OP0 == 2048 into OP0 - 2048 == 0.  */
+	      if (SMALL_OPERAND (-rhs))
 		{
 		  *op0 = gen_reg_rtx (GET_MODE (cmp_op0));
 		  riscv_emit_binary (PLUS, *op0, cmp_op0, GEN_INT (-rhs));
@@ -2262,11 +2913,11 @@ riscv_emit_compare (enum rtx_code *code, rtx *op0, rtx *op1)
 	    }
 	}
 
-      if ((*op1 == const0_rtx) || ((Pulp_Cpu>=PULP_V2) && (*code == EQ || *code == NE) && (GET_CODE(*op1) == CONST_INT) &&
-	  (INTVAL(*op1) >= -16) && (INTVAL(*op1) <= 15))) {
-      } else {
+      /* Keep the small immediates that p.beqimm/p.bneimm can encode.  */
+      if (*op1 != const0_rtx
+	  && !((*code == EQ || *code == NE)
+	       && reg_or_imm5_operand (*op1, VOIDmode)))
 	*op1 = force_reg (GET_MODE (cmp_op0), *op1);
-      }
 
     }
   else
@@ -2415,34 +3066,133 @@ void riscv_expand_vector_init(rtx target, rtx vals)
 	}
 }
 
-int riscv_replicated_const_vector (rtx op, int min_val, int max_val)
+/* Expand a dot product reduction on 64-bit vectors. OPERANDS are those of
+   sdot_prod<mode>: each half of the V8QI/V4HI inputs 1 and 2 goes to its
+   own pv.sdot, generated by GEN, accumulating in the matching SI element
+   of the V2SI accumulator 3. Result in operand 0.  */
+
+void riscv_expand_dot_prod_pairs (rtx *operands, rtx (*gen) (rtx, rtx, rtx, rtx))
 
 {
-        if (GET_CODE (op) == CONST_VECTOR) {
-                enum machine_mode mode = GET_MODE(op);
-                enum machine_mode inner_mode = GET_MODE_INNER (mode);
-                HOST_WIDE_INT ref=0;
-                int ref1;
-                HOST_WIDE_INT mask = GET_MODE_MASK (inner_mode);
-                int i;
+	enum machine_mode in_mode = GET_MODE (operands[1]);
+	enum machine_mode half_mode = (in_mode == V8QImode) ? V4QImode : V2HImode;
+	rtx acc[2];
+	int i;
 
-                for (i = 0; i < GET_MODE_NUNITS (mode); i++) {
-                        HOST_WIDE_INT cval = INTVAL (CONST_VECTOR_ELT (op, i)) & mask;
-                        if (i==0) ref = cval;
-                        else if (ref != cval) return 0;
-                }
-                if (GET_MODE_NUNITS (mode) == 2) ref1 = ((int)ref<<16)>>16; else ref1 = ((int)ref<<24)>>24;
-                return (((int) ref1 >= min_val) && ((int) ref1 <= max_val));
-        }
-        return 0;
+	for (i = 0; i < 2; i++) {
+		acc[i] = gen_reg_rtx (SImode);
+		emit_move_insn (acc[i], simplify_gen_subreg (SImode, operands[3], V2SImode, i * UNITS_PER_WORD));
+		emit_insn (gen (acc[i],
+				force_reg (half_mode, simplify_gen_subreg (half_mode, operands[1], in_mode, i * UNITS_PER_WORD)),
+				force_reg (half_mode, simplify_gen_subreg (half_mode, operands[2], in_mode, i * UNITS_PER_WORD)),
+				acc[i]));
+	}
+	emit_clobber (operands[0]);
+	for (i = 0; i < 2; i++)
+		emit_move_insn (simplify_gen_subreg (SImode, operands[0], V2SImode, i * UNITS_PER_WORD), acc[i]);
 }
 
-rtx
-riscv_to_int_mode (rtx x)
-{
-  enum machine_mode mode = GET_MODE (x);
-  return VOIDmode == mode ? x : simplify_gen_subreg (int_mode_for_mode (mode), x, mode, 0);
-}
+/* Permute the bytes of IN1 and IN2 into TARGET with pv.shuffle2.b, SEL
+   giving the vec_perm indexes of the four result bytes.  */
+
+static void riscv_expand_byte_shuffle (rtx target, rtx in1, rtx in2, const int *sel)
+
+{
+	rtx elts[4];
+	int i;
+
+	for (i = 0; i < 4; i++) elts[i] = GEN_INT (sel[i]);
+	emit_insn (gen_vec_permv4qi (target, force_reg (V4QImode, gen_lowpart (V4QImode, in1)),
+				     force_reg (V4QImode, gen_lowpart (V4QImode, in2)),
+				     force_reg (V4QImode, gen_rtx_CONST_VECTOR (V4QImode, gen_rtvec_v (4, elts)))));
+}
+
+/* Expand vec_unpack[su]_{lo,hi}_v4qi: widen bytes 0,1 (HIGH_P false) or
+   2,3 of the V4QI OP1 into the V2HI OP0. Unsigned bytes are interleaved
+   with a zero vector by a single pv.shuffle2.b, signed ones go through
+   two pv.extract.b and a pv.pack.h.  */
+
+void riscv_expand_vec_unpack (rtx op0, rtx op1, bool unsigned_p, bool high_p)
+
+{
+	int first = high_p ? 2 : 0;
+
+	if (unsigned_p) {
+		int sel[4] = {first, 4, first + 1, 4};
+		rtx res = gen_reg_rtx (V4QImode);
+
+		riscv_expand_byte_shuffle (res, op1, CONST0_RTX (V4QImode), sel);
+		emit_move_insn (op0, gen_lowpart (V2HImode, res));
+	} else {
+		rtx lo = gen_reg_rtx (HImode), hi = gen_reg_rtx (HImode);
+
+		emit_insn (gen_vec_extract_sext_hi_v4qi (lo, op1, GEN_INT (first)));
+		emit_insn (gen_vec_extract_sext_hi_v4qi (hi, op1, GEN_INT (first + 1)));
+		emit_insn (gen_vec_pack_v2hi (op0, lo, hi));
+	}
+}
+
+/* Return a register holding the V2HI vector {VAL, VAL}.  */
+
+static rtx riscv_splat_v2hi (int val)
+
+{
+	return force_reg (V2HImode, gen_rtx_CONST_VECTOR (V2HImode, gen_rtvec (2, GEN_INT (val), GEN_INT (val))));
+}
+
+/* Expand vec_pack_{trunc,ssat,usat}_v2hi: narrow the V2HI OP1 and OP2 into
+   the V4QI OP0, OP1 giving bytes 0,1. SAT is 0 for truncation, otherwise
+   the elements are first clamped with pv.max.h/pv.min.h (SAT > 0, signed)
+   or pv.minu.h (SAT < 0, unsigned) to the 8-bit range.  */
+
+void riscv_expand_vec_pack (rtx op0, rtx op1, rtx op2, int sat)
+
+{
+	static const int sel[4] = {0, 2, 4, 6};
+	rtx ops[2] = {op1, op2};
+	int i;
+
+	for (i = 0; sat && i < 2; i++) {
+		rtx t = gen_reg_rtx (V2HImode);
+
+		if (sat > 0) {
+			emit_insn (gen_smaxv2hi3 (t, ops[i], riscv_splat_v2hi (-128)));
+			emit_insn (gen_sminv2hi3 (t, t, riscv_splat_v2hi (127)));
+		} else
+			emit_insn (gen_uminv2hi3 (t, ops[i], riscv_splat_v2hi (255)));
+		ops[i] = t;
+	}
+	riscv_expand_byte_shuffle (op0, ops[0], ops[1], sel);
+}
+
+int riscv_replicated_const_vector (rtx op, int min_val, int max_val)
+
+{
+        if (GET_CODE (op) == CONST_VECTOR && GET_MODE_CLASS (GET_MODE (op)) == MODE_VECTOR_INT) {
+                enum machine_mode mode = GET_MODE(op);
+                enum machine_mode inner_mode = GET_MODE_INNER (mode);
+                HOST_WIDE_INT ref=0;
+                int ref1;
+                HOST_WIDE_INT mask = GET_MODE_MASK (inner_mode);
+                int i;
+
+                for (i = 0; i < GET_MODE_NUNITS (mode); i++) {
+                        HOST_WIDE_INT cval = INTVAL (CONST_VECTOR_ELT (op, i)) & mask;
+                        if (i==0) ref = cval;
+                        else if (ref != cval) return 0;
+                }
+                if (GET_MODE_NUNITS (mode) == 2) ref1 = ((int)ref<<16)>>16; else ref1 = ((int)ref<<24)>>24;
+                return (((int) ref1 >= min_val) && ((int) ref1 <= max_val));
+        }
+        return 0;
+}
+
+rtx
+riscv_to_int_mode (rtx x)
+{
+  enum machine_mode mode = GET_MODE (x);
+  return VOIDmode == mode ? x : simplify_gen_subreg (int_mode_for_mode (mode), x, mode, 0);
+}
 
 /* Various helper to validate operands for pulp v2 */
 
@@ -2491,6 +3241,303 @@ int riscv_valid_norm_round_imm_op(rtx norm_oper, rtx round_oper, int MaxVal)
 	return 0;
 }
 
+/* Return the value of X if it is a constant, or a pseudo whose only
+   definition loads a constant.  The latter is what the rounding constant
+   of a normalization becomes once it has been hoisted out of a loop.  */
+
+static rtx
+riscv_known_constant (rtx x)
+{
+  df_ref def;
+  rtx_insn *insn;
+  rtx set, note;
+
+  if (CONST_INT_P (x))
+    return x;
+  if (!REG_P (x) || HARD_REGISTER_P (x))
+    return NULL_RTX;
+
+  def = DF_REG_DEF_CHAIN (REGNO (x));
+  if (!def || DF_REF_NEXT_REG (def) || DF_REF_IS_ARTIFICIAL (def))
+    return NULL_RTX;
+
+  insn = DF_REF_INSN (def);
+  set = single_set (insn);
+  if (!set || !REG_P (SET_DEST (set)) || REGNO (SET_DEST (set)) != REGNO (x))
+    return NULL_RTX;
+  if (CONST_INT_P (SET_SRC (set)))
+    return SET_SRC (set);
+  note = find_reg_equal_equiv_note (insn);
+  if (note && CONST_INT_P (XEXP (note, 0)))
+    return XEXP (note, 0);
+  return NULL_RTX;
+}
+
+/* If X, a factor of a 16x16 product, is a half word extended to SImode
+   as UNSIGNED_P says, return it as an HImode operand.  Set *HIGH_P and
+   return the register if X selects the upper half word of a register
+   instead.  Set *CHANGED_P if X is a plain register that is only known
+   to hold an extended half word.  Return NULL_RTX otherwise.  */
+
+static rtx
+riscv_half_word_factor (rtx x, bool unsigned_p, bool *high_p, bool *changed_p)
+{
+  enum rtx_code ext = unsigned_p ? ZERO_EXTEND : SIGN_EXTEND;
+  enum rtx_code shift = unsigned_p ? LSHIFTRT : ASHIFTRT;
+
+  *high_p = false;
+  if (GET_CODE (x) == ext && register_operand (XEXP (x, 0), HImode))
+    return XEXP (x, 0);
+
+  if (GET_CODE (x) == shift && register_operand (XEXP (x, 0), SImode)
+      && CONST_INT_P (XEXP (x, 1)) && INTVAL (XEXP (x, 1)) == 16)
+    {
+      *high_p = true;
+      return XEXP (x, 0);
+    }
+
+  if (register_operand (x, SImode)
+      && (unsigned_p
+	  ? (nonzero_bits (x, SImode) & ~(unsigned HOST_WIDE_INT) 0xffff) == 0
+	  : num_sign_bit_copies (x, SImode) > 16))
+    {
+      *changed_p = true;
+      return gen_lowpart (HImode, x);
+    }
+  return NULL_RTX;
+}
+
+/* Try to emit DEST = (CODE X SHIFT), CODE being ASHIFTRT or LSHIFTRT, as
+   one of the Xpulpv2 normalizing instructions (p.mulsN, p.mulsRN,
+   p.macsN, p.macsRN, their unsigned and upper half word forms, and
+   p.addRN).  This is used by combine when the expression is not in the
+   shape of the patterns: factors that are half words without an explicit
+   extension, or a rounding constant that lives in a register.  Return
+   false if no instruction applies or if the patterns would already have
+   matched.  */
+
+bool
+riscv_split_norm_round (rtx dest, rtx x, rtx shift, enum rtx_code code)
+{
+  bool unsigned_p = (code == LSHIFTRT);
+  bool changed_p = false, high_a, high_b;
+  rtx terms[3], mult = NULL_RTX, round = NULL_RTX, acc[2];
+  rtx a, b, c;
+  int nterms = 0, nacc = 0, i;
+  HOST_WIDE_INT n = INTVAL (shift);
+
+  if (n < 1 || n > 31)
+    return false;
+
+  /* Flatten the sum into at most three terms.  */
+  if (GET_CODE (x) == PLUS)
+    for (i = 0; i < 2; i++)
+      {
+	rtx op = XEXP (x, i);
+	if (GET_CODE (op) != PLUS)
+	  terms[nterms++] = op;
+	else if (nterms + 2 + (1 - i) <= 3)
+	  {
+	    terms[nterms++] = XEXP (op, 0);
+	    terms[nterms++] = XEXP (op, 1);
+	  }
+	else
+	  return false;
+      }
+  else
+    terms[nterms++] = x;
+
+  for (i = 0; i < nterms; i++)
+    {
+      c = riscv_known_constant (terms[i]);
+      if (GET_CODE (terms[i]) == MULT && !mult)
+	mult = terms[i];
+      else if (c && !round && INTVAL (c) == (HOST_WIDE_INT) 1 << (n - 1))
+	{
+	  round = c;
+	  if (!CONST_INT_P (terms[i]))
+	    changed_p = true;
+	}
+      else if (nacc < 2 && register_operand (terms[i], SImode))
+	acc[nacc++] = terms[i];
+      else
+	return false;
+    }
+
+  /* p.addRN: (a + b + round) >> n.  */
+  if (!mult)
+    {
+      if (!round || nacc != 2 || !changed_p || TARGET_MASK_NOADDSUBNORMROUND)
+	return false;
+      emit_insn (unsigned_p
+		 ? gen_addRNu_si3 (dest, acc[0], acc[1], shift, round)
+		 : gen_addRN_si3 (dest, acc[0], acc[1], shift, round));
+      return true;
+    }
+
+  if (nacc > 1 || GET_MODE (mult) != SImode || TARGET_MASK_NOMULMACNORMROUND)
+    return false;
+  a = riscv_half_word_factor (XEXP (mult, 0), unsigned_p, &high_a, &changed_p);
+  b = riscv_half_word_factor (XEXP (mult, 1), unsigned_p, &high_b, &changed_p);
+  if (!a || !b || high_a != high_b || !changed_p)
+    return false;
+
+  if (nacc == 0 && !round)
+    emit_insn (high_a
+	       ? (unsigned_p ? gen_mulhhuNr_si3 (dest, a, b, shift)
+			     : gen_mulhhsNr_si3 (dest, a, b, shift))
+	       : (unsigned_p ? gen_muluNr_si3 (dest, a, b, shift)
+			     : gen_mulsNr_si3 (dest, a, b, shift)));
+  else if (nacc == 0)
+    emit_insn (high_a
+	       ? (unsigned_p ? gen_mulhhuRNr_si3 (dest, a, b, shift, round)
+			     : gen_mulhhsRNr_si3 (dest, a, b, shift, round))
+	       : (unsigned_p ? gen_muluRNr_si3 (dest, a, b, shift, round)
+			     : gen_mulsRNr_si3 (dest, a, b, shift, round)));
+  else if (!round)
+    emit_insn (high_a
+	       ? (unsigned_p ? gen_machhuNr_si3 (dest, a, b, acc[0], shift)
+			     : gen_machhsNr_si3 (dest, a, b, acc[0], shift))
+	       : (unsigned_p ? gen_macuNr_si3 (dest, a, b, acc[0], shift)
+			     : gen_macsNr_si3 (dest, a, b, acc[0], shift)));
+  else
+    emit_insn (high_a
+	       ? (unsigned_p ? gen_machhuRNr_si3 (dest, a, b, acc[0], shift, round)
+			     : gen_machhsRNr_si3 (dest, a, b, acc[0], shift, round))
+	       : (unsigned_p ? gen_macuRNr_si3 (dest, a, b, acc[0], shift, round)
+			     : gen_macsRNr_si3 (dest, a, b, acc[0], shift, round)));
+  return true;
+}
+
+/* Set *LO and *HI to the smallest and largest values of fixed-point
+   mode MODE, counted in units of its least significant bit.  */
+
+static void
+riscv_fixed_range (enum machine_mode mode, HOST_WIDE_INT *lo, HOST_WIDE_INT *hi)
+{
+  int bits = GET_MODE_IBIT (mode) + GET_MODE_FBIT (mode);
+
+  *hi = ((HOST_WIDE_INT) 1 << bits) - 1;
+  *lo = SIGNED_FIXED_POINT_MODE_P (mode) ? -((HOST_WIDE_INT) 1 << bits) : 0;
+}
+
+/* Return fixed-point value X of mode MODE extended into an SImode
+   register according to the signedness of MODE.  */
+
+static rtx
+riscv_fixed_to_si (rtx x, enum machine_mode mode)
+{
+  enum machine_mode imode = int_mode_for_mode (mode);
+
+  x = convert_modes (SImode, imode, gen_lowpart (imode, x),
+		     UNSIGNED_FIXED_POINT_MODE_P (mode));
+  return force_reg (SImode, x);
+}
+
+/* Clamp SImode register X to [LO, HI] and return the result.  Ranges of
+   the form [-2^n, 2^n - 1] and [0, 2^n - 1] give a single p.clip or
+   p.clipu, others a p.min/p.max pair.  */
+
+static rtx
+riscv_fixed_clamp (rtx x, HOST_WIDE_INT lo, HOST_WIDE_INT hi)
+{
+  rtx lo_rtx = GEN_INT (lo), hi_rtx = GEN_INT (hi);
+  rtx t;
+
+  if (riscv_valid_clip_operands (hi_rtx, lo_rtx, lo != 0))
+    {
+      t = gen_reg_rtx (SImode);
+      emit_insn (gen_rtx_SET (VOIDmode, t,
+			      gen_rtx_SMAX (SImode,
+					    gen_rtx_SMIN (SImode, x, hi_rtx),
+					    lo_rtx)));
+      return t;
+    }
+  x = expand_simple_binop (SImode, SMIN, x, hi_rtx, NULL_RTX, 0, OPTAB_DIRECT);
+  return expand_simple_binop (SImode, SMAX, x, lo_rtx, NULL_RTX, 0, OPTAB_DIRECT);
+}
+
+/* Expand fixed-point OPERANDS[0] = OPERANDS[1] CODE OPERANDS[2] for a
+   mode narrower than a word, saturating if SAT_P.  PLUS and MINUS are
+   done on the extended operands; MULT is a halfword p.mulsN/p.muluN
+   normalized by the number of fractional bits, truncating as the constant
+   folder does.  The SImode result is
+   then clipped to the mode range when saturating.  */
+
+void
+riscv_expand_fixed_arith (enum rtx_code code, rtx *operands, bool sat_p)
+{
+  enum machine_mode mode = GET_MODE (operands[0]);
+  HOST_WIDE_INT lo, hi;
+  rtx x;
+
+  if (code == MULT)
+    {
+      int fbit = GET_MODE_FBIT (mode);
+      rtx a = gen_lowpart (HImode, operands[1]);
+      rtx b = gen_lowpart (HImode, operands[2]);
+
+      x = gen_reg_rtx (SImode);
+      if (SIGNED_FIXED_POINT_MODE_P (mode))
+	emit_insn (gen_mulsNr_si3 (x, a, b, GEN_INT (fbit)));
+      else
+	emit_insn (gen_muluNr_si3 (x, a, b, GEN_INT (fbit)));
+    }
+  else
+    x = force_reg (SImode,
+		   expand_simple_binop (SImode, code,
+					riscv_fixed_to_si (operands[1], mode),
+					riscv_fixed_to_si (operands[2], mode),
+					NULL_RTX, 0, OPTAB_DIRECT));
+
+  if (sat_p)
+    {
+      riscv_fixed_range (mode, &lo, &hi);
+      x = riscv_fixed_clamp (x, lo, hi);
+    }
+  emit_move_insn (operands[0], gen_lowpart (mode, x));
+}
+
+/* Expand a conversion of fixed-point SRC into fixed-point DEST, both
+   fitting SImode with their signedness.  SRC is extended, clipped to
+   the range of DEST when SAT_P, then shifted to the fractional bits of
+   DEST.  Dropped fractional bits are truncated, as the constant folder
+   does.  */
+
+void
+riscv_expand_fixed_convert (rtx dest, rtx src, bool sat_p)
+{
+  enum machine_mode dmode = GET_MODE (dest), smode = GET_MODE (src);
+  int shift = GET_MODE_FBIT (dmode) - GET_MODE_FBIT (smode);
+  rtx x = riscv_fixed_to_si (src, smode);
+
+  if (sat_p)
+    {
+      HOST_WIDE_INT lo, hi, slo, shi;
+
+      /* Express the range of DEST in units of SRC.  */
+      riscv_fixed_range (dmode, &lo, &hi);
+      if (shift > 0)
+	lo >>= shift, hi >>= shift;
+      else if (shift < 0)
+	{
+	  lo *= (HOST_WIDE_INT) 1 << -shift;
+	  hi = (hi + 1) * ((HOST_WIDE_INT) 1 << -shift) - 1;
+	}
+      riscv_fixed_range (smode, &slo, &shi);
+      if (lo > slo || hi < shi)
+	x = riscv_fixed_clamp (x, MAX (lo, slo), MIN (hi, shi));
+    }
+
+  if (shift > 0)
+    x = expand_simple_binop (SImode, ASHIFT, x, GEN_INT (shift),
+			     NULL_RTX, 0, OPTAB_DIRECT);
+  else if (shift < 0)
+    x = expand_simple_binop (SImode, ASHIFTRT, x, GEN_INT (-shift),
+			     NULL_RTX, 0, OPTAB_DIRECT);
+  emit_move_insn (dest, gen_lowpart (dmode, force_reg (SImode, x)));
+}
+
 bool riscv_valid_bit_field_imm_operand(rtx x, rtx shift_op, int Set_Mode, int *Size, int *Offset)
 
 {
@@ -2627,7 +3674,12 @@ static bool riscv_vector_mode_supported_p (enum machine_mode mode)
     case V2HImode:
     case V4QImode:
     case V2QImode:
+    case V2HFmode:
       return true;
+    case V8QImode:
+    case V4HImode:
+    case V2SImode:
+      return !TARGET_64BIT && (Pulp_Cpu>=PULP_V2) && !TARGET_MASK_NOVECT;
     default:
       return false;
     }
@@ -2648,6 +3700,152 @@ static enum machine_mode riscv_preferred_simd_mode (enum machine_mode mode)
     }
 }
 
+/* Implements TARGET_VECTORIZE_AUTOVECTORIZE_VECTOR_SIZES. Vectors are one
+   word wide, but an int has no vector type of that size so reductions of
+   char or short products into an int fail. The vectorizer then retries
+   with two word vectors, where sdot_prod<mode> splits the work over a
+   pair of pv.sdot. Loops using two word vectors for anything but a dot
+   product are rejected by riscv_finish_cost.  */
+
+static unsigned int
+riscv_autovectorize_vector_sizes (void)
+{
+  if (!TARGET_64BIT && (Pulp_Cpu>=PULP_V2) && !TARGET_MASK_NOVECT)
+    return 2 * UNITS_PER_WORD | UNITS_PER_WORD;
+  return 0;
+}
+
+/* The vectorizer only builds a dot product when the product is exactly
+   twice as wide as its factors, so acc += (int) a[i] * (int) b[i] over
+   chars never reaches pv.sdotsp.b. Return true if OP is a widening of an
+   8-bit value, stored in *NARROW.  */
+
+static bool
+riscv_byte_factor_p (tree op, tree *narrow)
+{
+  gimple def;
+
+  if (TREE_CODE (op) != SSA_NAME)
+    return false;
+  def = SSA_NAME_DEF_STMT (op);
+  if (!is_gimple_assign (def) || !CONVERT_EXPR_CODE_P (gimple_assign_rhs_code (def)))
+    return false;
+  *narrow = gimple_assign_rhs1 (def);
+  return INTEGRAL_TYPE_P (TREE_TYPE (*narrow)) && TYPE_PRECISION (TREE_TYPE (*narrow)) == 8;
+}
+
+/* Return true if the product STMT of LOOP only feeds a sum reduction,
+   acc = acc + STMT with acc a phi of the loop header, i.e. it is the
+   candidate of a dot product. LOOP has to be innermost, the vectorizer
+   does not handle the others.  */
+
+static bool
+riscv_dot_prod_candidate_p (gimple stmt, struct loop *loop)
+{
+  use_operand_p use_p;
+  gimple use_stmt;
+  tree lhs = gimple_assign_lhs (stmt), acc;
+
+  if (loop->inner || !single_imm_use (lhs, &use_p, &use_stmt))
+    return false;
+  if (!is_gimple_assign (use_stmt) || gimple_assign_rhs_code (use_stmt) != PLUS_EXPR
+      || gimple_bb (use_stmt)->loop_father != loop)
+    return false;
+  acc = (gimple_assign_rhs1 (use_stmt) == lhs) ? gimple_assign_rhs2 (use_stmt)
+					       : gimple_assign_rhs1 (use_stmt);
+  return TREE_CODE (acc) == SSA_NAME
+	 && gimple_code (SSA_NAME_DEF_STMT (acc)) == GIMPLE_PHI
+	 && gimple_bb (SSA_NAME_DEF_STMT (acc)) == loop->header;
+}
+
+/* Rewrite the 32-bit products of two bytes that are dot product candidates
+   into the widening of a 16-bit product, (int) ((short) a * (short) b). The
+   16-bit product cannot overflow, unsigned short is used for unsigned bytes.
+   Other products are left alone, narrowing them only costs an extension.  */
+
+static unsigned int
+riscv_narrow_byte_products (function *fun)
+{
+  basic_block bb;
+
+  FOR_EACH_BB_FN (bb, fun)
+    {
+      gimple_stmt_iterator gsi;
+
+      if (!bb->loop_father || loop_depth (bb->loop_father) == 0)
+	continue;
+      for (gsi = gsi_start_bb (bb); !gsi_end_p (gsi); gsi_next (&gsi))
+	{
+	  gimple stmt = gsi_stmt (gsi);
+	  tree a, b, half, na, nb, prod;
+
+	  if (!is_gimple_assign (stmt) || gimple_assign_rhs_code (stmt) != MULT_EXPR
+	      || TREE_CODE (TREE_TYPE (gimple_assign_lhs (stmt))) != INTEGER_TYPE
+	      || TYPE_PRECISION (TREE_TYPE (gimple_assign_lhs (stmt))) != 32)
+	    continue;
+	  if (!riscv_byte_factor_p (gimple_assign_rhs1 (stmt), &a)
+	      || !riscv_byte_factor_p (gimple_assign_rhs2 (stmt), &b)
+	      || TYPE_UNSIGNED (TREE_TYPE (a)) != TYPE_UNSIGNED (TREE_TYPE (b))
+	      || !riscv_dot_prod_candidate_p (stmt, bb->loop_father))
+	    continue;
+
+	  half = TYPE_UNSIGNED (TREE_TYPE (a)) ? short_unsigned_type_node : short_integer_type_node;
+	  na = make_ssa_name (half);
+	  gsi_insert_before (&gsi, gimple_build_assign (na, NOP_EXPR, a), GSI_SAME_STMT);
+	  nb = make_ssa_name (half);
+	  gsi_insert_before (&gsi, gimple_build_assign (nb, NOP_EXPR, b), GSI_SAME_STMT);
+	  prod = make_ssa_name (half);
+	  gsi_insert_before (&gsi, gimple_build_assign (prod, MULT_EXPR, na, nb), GSI_SAME_STMT);
+	  gimple_assign_set_rhs_with_ops (&gsi, NOP_EXPR, prod);
+	  update_stmt (gsi_stmt (gsi));
+	  if (dump_file)
+	    fprintf (dump_file, "Narrowed byte product in bb %d\n", bb->index);
+	}
+    }
+  return 0;
+}
+
+namespace {
+
+const pass_data pass_data_riscv_dot_prod =
+{
+  GIMPLE_PASS, /* type */
+  "dotprod", /* name */
+  OPTGROUP_VEC, /* optinfo_flags */
+  TV_NONE, /* tv_id */
+  ( PROP_cfg | PROP_ssa ), /* properties_required */
+  0, /* properties_provided */
+  0, /* properties_destroyed */
+  0, /* todo_flags_start */
+  0, /* todo_flags_finish */
+};
+
+class pass_riscv_dot_prod : public gimple_opt_pass
+{
+public:
+  pass_riscv_dot_prod (gcc::context *ctxt)
+    : gimple_opt_pass (pass_data_riscv_dot_prod, ctxt)
+  {}
+
+  virtual bool gate (function *)
+  {
+    return flag_tree_loop_vectorize && !TARGET_64BIT && (Pulp_Cpu>=PULP_V2) && !TARGET_MASK_NOVECT;
+  }
+  virtual unsigned int execute (function *fun) { return riscv_narrow_byte_products (fun); }
+};
+
+} // anon namespace
+
+/* Run the byte product narrowing right before the loop vectorizer.  */
+static void
+riscv_register_dot_prod_pass (void)
+{
+  opt_pass *pass_dot_prod = new pass_riscv_dot_prod (g);
+  struct register_pass_info dot_prod = { pass_dot_prod, "vect", 1, PASS_POS_INSERT_BEFORE };
+
+  register_pass (&dot_prod);
+}
+
 /* Implements TARGET_VECTORIZE_SUPPORT_VECTOR_MISALIGNMENT */
 
 static bool
@@ -2679,13 +3877,19 @@ riscv_vector_alignment_reachable (const_tree type ATTRIBUTE_UNUSED, bool is_pack
     return !is_packed;
 }
 
-/* Implements TARGET_VECTORIZE_BUILTIN_VECTORIZATION_COST */
+/* Implements TARGET_VECTORIZE_BUILTIN_VECTORIZATION_COST. The vector costs
+   come from the pv.* sequences riscv.md emits for each statement kind, see
+   riscv_vector_cost.  */
 
 static int
 riscv_builtin_vectorization_cost (enum vect_cost_for_stmt type_of_cost,
                                  tree vectype,
-                                 int misalign ATTRIBUTE_UNUSED)
+                                 int misalign)
 {
+  const struct riscv_vector_cost *costs = tune_info->vec_costs;
+  bool qi_p = vectype && GET_MODE_INNER (TYPE_MODE (vectype)) == QImode;
+  /* Two word vectors are handled one word at a time.  */
+  int words = (vectype && GET_MODE_SIZE (TYPE_MODE (vectype)) > UNITS_PER_WORD) ? 2 : 1;
   unsigned elements;
 
   switch (type_of_cost)
@@ -2693,32 +3897,147 @@ riscv_builtin_vectorization_cost (enum vect_cost_for_stmt type_of_cost,
       case scalar_stmt:
       case scalar_load:
       case scalar_store:
+        return 1;
+
       case vector_stmt:
+        return words * costs->stmt;
+
       case vector_load:
+        return words * costs->load;
+
       case vector_store:
-      case vec_to_scalar:
-      case scalar_to_vec:
-      case cond_branch_not_taken:
-      case vec_perm:
-      case vec_promote_demote:
-        return 1;
+        return words * costs->store;
 
+      /* A misalignment that keeps the access inside a word is free.  */
       case unaligned_load:
+        if (misalign >= 0 && (misalign % UNITS_PER_WORD) == 0)
+          return words * costs->load;
+        return words * costs->unaligned_load;
+
       case unaligned_store:
-        return 1;
+        if (misalign >= 0 && (misalign % UNITS_PER_WORD) == 0)
+          return words * costs->store;
+        return words * costs->unaligned_store;
 
-      case cond_branch_taken:
-        return 1;
+      case vec_perm:
+        return costs->perm[qi_p];
+
+      case vec_promote_demote:
+        return costs->promote_demote[qi_p];
+
+      /* Broadcast of a scalar: pv.add.sc.  */
+      case scalar_to_vec:
+        return costs->lane_insert;
+
+      /* Lane extraction, also used for reduction epilogues.  */
+      case vec_to_scalar:
+        return costs->lane_extract;
 
+      /* riscv_expand_vector_init inserts each lane in turn.  */
       case vec_construct:
         elements = TYPE_VECTOR_SUBPARTS (vectype);
-        return elements / 2 + 1;
+        return elements * costs->lane_insert;
+
+      case cond_branch_not_taken:
+        return costs->cond_not_taken_branch;
+
+      case cond_branch_taken:
+        return costs->cond_taken_branch;
 
       default:
         gcc_unreachable ();
     }
 }
 
+/* Vectorizer cost data. Two word vectors only exist for the pv.sdot pairs
+   of sdot_prod<mode>, anything else in them is two single word operations
+   plus the GPR pair moves, never better than the scalar loop.  */
+
+struct riscv_vect_cost_data
+{
+  unsigned cost[3];	/* Indexed by enum vect_cost_model_location.  */
+  bool wide_p;		/* A two word vector is used.  */
+  bool dot_prod_p;	/* A dot product is vectorized.  */
+};
+
+/* Body cost of a rejected vectorization. The vectorizer compares it as an
+   int with the scalar iteration cost times the vectorization factor, half
+   the unsigned range is the largest value that no scalar body can reach
+   and that does not wrap there.  */
+#define RISCV_VECT_COST_REJECT (UINT_MAX / 2)
+
+/* Implements TARGET_VECTORIZE_INIT_COST.  */
+
+static void *
+riscv_init_cost (struct loop *loop_info ATTRIBUTE_UNUSED)
+{
+  return xcalloc (1, sizeof (struct riscv_vect_cost_data));
+}
+
+/* Return true if STMT_INFO is, or is replaced by, a dot product.  */
+
+static bool
+riscv_dot_prod_stmt_p (struct _stmt_vec_info *stmt_info)
+{
+  gimple stmt = STMT_VINFO_STMT (stmt_info);
+
+  if (STMT_VINFO_IN_PATTERN_P (stmt_info) && STMT_VINFO_RELATED_STMT (stmt_info))
+    stmt = STMT_VINFO_RELATED_STMT (stmt_info);
+  return is_gimple_assign (stmt) && gimple_assign_rhs_code (stmt) == DOT_PROD_EXPR;
+}
+
+/* Implements TARGET_VECTORIZE_ADD_STMT_COST, as the default one but
+   recording the use of two word vectors and of dot products.  */
+
+static unsigned
+riscv_add_stmt_cost (void *data, int count, enum vect_cost_for_stmt kind,
+		     struct _stmt_vec_info *stmt_info, int misalign,
+		     enum vect_cost_model_location where)
+{
+  struct riscv_vect_cost_data *cost_data = (struct riscv_vect_cost_data *) data;
+  tree vectype = stmt_info ? stmt_vectype (stmt_info) : NULL_TREE;
+  unsigned retval;
+
+  if (vectype && GET_MODE_SIZE (TYPE_MODE (vectype)) > UNITS_PER_WORD)
+    cost_data->wide_p = true;
+  if (stmt_info && riscv_dot_prod_stmt_p (stmt_info))
+    cost_data->dot_prod_p = true;
+
+  /* Statements in an inner loop relative to the loop being vectorized
+     are weighted more heavily, as in default_add_stmt_cost.  */
+  if (where == vect_body && stmt_info && stmt_in_inner_loop_p (stmt_info))
+    count *= 50;
+
+  retval = (unsigned) (count * riscv_builtin_vectorization_cost (kind, vectype, misalign));
+  cost_data->cost[where] += retval;
+  return retval;
+}
+
+/* Implements TARGET_VECTORIZE_FINISH_COST. Two word vectors without a dot
+   product are rejected, whether a dot product is there is only known once
+   every statement has been costed.  */
+
+static void
+riscv_finish_cost (void *data, unsigned *prologue_cost,
+		   unsigned *body_cost, unsigned *epilogue_cost)
+{
+  struct riscv_vect_cost_data *cost_data = (struct riscv_vect_cost_data *) data;
+
+  *prologue_cost = cost_data->cost[vect_prologue];
+  *body_cost = cost_data->cost[vect_body];
+  *epilogue_cost = cost_data->cost[vect_epilogue];
+  if (cost_data->wide_p && !cost_data->dot_prod_p)
+    *body_cost = RISCV_VECT_COST_REJECT;
+}
+
+/* Implements TARGET_VECTORIZE_DESTROY_COST_DATA.  */
+
+static void
+riscv_destroy_cost_data (void *data)
+{
+  free (data);
+}
+
 /* Implement TARGET_FUNCTION_ARG_BOUNDARY.  Every parameter gets at
    least PARM_BOUNDARY bits of alignment, but will be given anything up
    to STACK_BOUNDARY bits if the type requires it.  */
@@ -2760,7 +4079,8 @@ riscv_get_arg_info (struct riscv_arg_info *info, const CUMULATIVE_ARGS *cum,
 		 && (GET_MODE_CLASS (mode) == MODE_FLOAT
 		     || GET_MODE_CLASS (mode) == MODE_COMPLEX_FLOAT
 		     || GET_MODE_CLASS (mode) == MODE_VECTOR_FLOAT)
-		 && GET_MODE_UNIT_SIZE (mode) <= UNITS_PER_FPVALUE);
+		 && GET_MODE_UNIT_SIZE (mode) <= UNITS_PER_FPVALUE
+		 && !riscv_small_float_mode_p (mode));
 
   /* Complex floats should only go into FPRs if there are two FPRs free,
      otherwise they should be passed in the same way as a struct
@@ -2836,8 +4156,9 @@ riscv_function_arg (cumulative_args_t cum_v, enum machine_mode mode,
 
   /* The n32 and n64 ABIs say that if any 64-bit chunk of the structure
      contains a double in its entirety, then that 64-bit chunk is passed
-     in a floating-point register.  */
-  if (TARGET_HARD_FLOAT
+     in a floating-point register.  An F-only FPU cannot hold the DFmode
+     chunks, so it passes such structures in GPRs.  */
+  if (TARGET_DOUBLE_FLOAT
       && named
       && type != 0
       && TREE_CODE (type) == RECORD_TYPE
@@ -2990,7 +4311,8 @@ riscv_fpr_return_fields (const_tree valtype, tree *fields)
       if (TREE_CODE (field) != FIELD_DECL)
 	continue;
 
-      if (!SCALAR_FLOAT_TYPE_P (TREE_TYPE (field)))
+      if (!SCALAR_FLOAT_TYPE_P (TREE_TYPE (field))
+	  || riscv_small_float_mode_p (TYPE_MODE (TREE_TYPE (field))))
 	return 0;
 
       if (i == 2)
@@ -3010,7 +4332,8 @@ riscv_return_mode_in_fpr_p (enum machine_mode mode)
   return ((GET_MODE_CLASS (mode) == MODE_FLOAT
 	   || GET_MODE_CLASS (mode) == MODE_VECTOR_FLOAT
 	   || GET_MODE_CLASS (mode) == MODE_COMPLEX_FLOAT)
-	  && GET_MODE_UNIT_SIZE (mode) <= UNITS_PER_HWFPVALUE);
+	  && GET_MODE_UNIT_SIZE (mode) <= UNITS_PER_HWFPVALUE
+	  && !riscv_small_float_mode_p (mode));
 }
 
 /* Return the representation of an FPR return register when the
@@ -3198,6 +4521,7 @@ rtx
 riscv_expand_call (bool sibcall_p, rtx result, rtx addr, rtx args_size)
 {
   rtx pattern;
+  rtx_insn *insn;
 
   if (!call_insn_operand (addr, VOIDmode))
     {
@@ -3247,7 +4571,22 @@ riscv_expand_call (bool sibcall_p, rtx result, rtx addr, rtx args_size)
       pattern = fn (result, addr, args_size);
     }
 
-  return emit_call_insn (pattern);
+  insn = emit_call_insn (pattern);
+
+  /* Tell -fipa-ra about the registers clobbered on the way to the callee:
+     the tail pseudo instruction goes through t1 and a PLT stub uses t1 to t3.  */
+  if (!REG_P (addr))
+    {
+      if (!absolute_symbolic_operand (addr, VOIDmode))
+	{
+	  clobber_reg (&CALL_INSN_FUNCTION_USAGE (insn), gen_rtx_REG (Pmode, GP_TEMP_FIRST + 1));
+	  clobber_reg (&CALL_INSN_FUNCTION_USAGE (insn), gen_rtx_REG (Pmode, GP_TEMP_FIRST + 2));
+	  clobber_reg (&CALL_INSN_FUNCTION_USAGE (insn), gen_rtx_REG (Pmode, GP_REG_FIRST + 28));
+	}
+      else if (sibcall_p)
+	clobber_reg (&CALL_INSN_FUNCTION_USAGE (insn), gen_rtx_REG (Pmode, GP_TEMP_FIRST + 1));
+    }
+  return insn;
 }
 
 /* Emit straight-line code to move LENGTH bytes from SRC to DEST.
@@ -3359,6 +4698,121 @@ riscv_block_move_loop (rtx dest, rtx src, HOST_WIDE_INT length,
     riscv_block_move_straight (dest, src, leftover);
 }
 
+/* Return a word of MEM at *REG, REG being post-incremented by the
+   access when the target has it, or at REG + OFFSET otherwise.  */
+
+static rtx
+riscv_block_word_mem (rtx mem, rtx reg, HOST_WIDE_INT offset)
+{
+  if (HAVE_POST_INCREMENT)
+    return change_address (mem, word_mode, gen_rtx_POST_INC (Pmode, reg));
+  return change_address (mem, word_mode, plus_constant (Pmode, reg, offset));
+}
+
+/* Emit DEST = SRC, one of them being a word returned by
+   riscv_block_word_mem for base register REG.  */
+
+static void
+riscv_block_word_move (rtx dest, rtx src, rtx reg)
+{
+  rtx_insn *insn = emit_insn (gen_rtx_SET (VOIDmode, dest, src));
+
+  if (HAVE_POST_INCREMENT)
+    add_reg_note (insn, REG_INC, reg);
+}
+
+/* Copy NWORDS words from SRC_REG to DEST_REG, or store WORD into them
+   when SRC_REG is null, and advance the base registers past them.  */
+
+static void
+riscv_block_words (rtx dest, rtx dest_reg, rtx src, rtx src_reg, rtx word,
+		   HOST_WIDE_INT nwords)
+{
+  HOST_WIDE_INT i;
+  rtx *regs = XALLOCAVEC (rtx, nwords);
+
+  if (nwords == 0)
+    return;
+
+  /* Issue the loads first to hide the load-use latency.  */
+  for (i = 0; i < nwords; i++)
+    if (src_reg)
+      {
+	regs[i] = gen_reg_rtx (word_mode);
+	riscv_block_word_move (regs[i], riscv_block_word_mem (src, src_reg, i * UNITS_PER_WORD), src_reg);
+      }
+  for (i = 0; i < nwords; i++)
+    riscv_block_word_move (riscv_block_word_mem (dest, dest_reg, i * UNITS_PER_WORD),
+			   src_reg ? regs[i] : word, dest_reg);
+
+  if (!HAVE_POST_INCREMENT)
+    {
+      riscv_emit_move (dest_reg, plus_constant (Pmode, dest_reg, nwords * UNITS_PER_WORD));
+      if (src_reg)
+	riscv_emit_move (src_reg, plus_constant (Pmode, src_reg, nwords * UNITS_PER_WORD));
+    }
+}
+
+/* Copy LENGTH bytes from word aligned SRC to word aligned DEST, or set
+   them to the replicated byte WORD when SRC is null.  Blocks of
+   BYTES_PER_ITER bytes are handled by a loop counted down in its own
+   register, so that doloop can turn it into a lp.setupi hardware loop
+   whose body is made of post-incremented p.lw/p.sw.  */
+
+static void
+riscv_block_op_loop (rtx dest, rtx src, rtx word, HOST_WIDE_INT length,
+		     HOST_WIDE_INT bytes_per_iter)
+{
+  HOST_WIDE_INT iters = length / bytes_per_iter;
+  rtx dest_reg, src_reg = NULL_RTX;
+  rtx label, count, test;
+
+  riscv_adjust_block_mem (dest, UNITS_PER_WORD, &dest_reg, &dest);
+  if (src)
+    riscv_adjust_block_mem (src, UNITS_PER_WORD, &src_reg, &src);
+
+  if (iters > 1)
+    {
+      count = force_reg (SImode, GEN_INT (iters));
+      label = gen_label_rtx ();
+      emit_label (label);
+
+      riscv_block_words (dest, dest_reg, src, src_reg, word, bytes_per_iter / UNITS_PER_WORD);
+
+      riscv_emit_move (count, plus_constant (SImode, count, -1));
+      test = gen_rtx_NE (VOIDmode, count, const0_rtx);
+      emit_jump_insn (gen_cbranchsi4 (test, count, const0_rtx, label));
+      length -= iters * bytes_per_iter;
+    }
+
+  riscv_block_words (dest, dest_reg, src, src_reg, word, length / UNITS_PER_WORD);
+  length %= UNITS_PER_WORD;
+
+  /* Mop up any left-over bytes.  */
+  if (length == 0)
+    return;
+  dest = change_address (dest, BLKmode, dest_reg);
+  set_mem_align (dest, BITS_PER_WORD);
+  if (src)
+    {
+      src = change_address (src, BLKmode, src_reg);
+      set_mem_align (src, BITS_PER_WORD);
+      move_by_pieces (dest, src, length, BITS_PER_WORD, 0);
+    }
+  else
+    {
+      HOST_WIDE_INT offset = 0;
+      enum machine_mode mode;
+
+      for (mode = HImode; length; mode = QImode)
+	for (; length >= GET_MODE_SIZE (mode); length -= GET_MODE_SIZE (mode))
+	  {
+	    riscv_emit_move (adjust_address (dest, mode, offset), gen_lowpart (mode, word));
+	    offset += GET_MODE_SIZE (mode);
+	  }
+    }
+}
+
 /* Expand a movmemsi instruction, which copies LENGTH bytes from
    memory reference SRC to memory reference DEST.  */
 
@@ -3377,24 +4831,149 @@ riscv_expand_block_move (rtx dest, rtx src, rtx length)
 	  riscv_block_move_straight (dest, src, INTVAL (length));
 	  return true;
 	}
-      else if (optimize && align >= BITS_PER_WORD)
+      else if (optimize && align >= BITS_PER_WORD
+	       && INTVAL (length) <= tune_info->block_inline_max)
 	{
-	  riscv_block_move_loop (dest, src, INTVAL (length),
-				RISCV_MAX_MOVE_BYTES_PER_LOOP_ITER / factor);
+	  if (HAVE_POST_INCREMENT)
+	    riscv_block_op_loop (dest, src, NULL_RTX, INTVAL (length),
+				 RISCV_MAX_MOVE_BYTES_PER_LOOP_ITER);
+	  else
+	    riscv_block_move_loop (dest, src, INTVAL (length),
+				   RISCV_MAX_MOVE_BYTES_PER_LOOP_ITER / factor);
 	  return true;
 	}
     }
   return false;
 }
 
+/* Expand a setmemsi instruction, which sets LENGTH bytes of memory
+   reference DEST to the byte VALUE.  Only word aligned blocks of known
+   size are handled inline, anything else calls memset.  Blocks of at most
+   RISCV_MAX_MOVE_BYTES_STRAIGHT bytes are set with straight-line stores,
+   as in riscv_expand_block_move, larger ones up to block_inline_max
+   with a loop.  */
+
+bool
+riscv_expand_block_set (rtx dest, rtx length, rtx value)
+{
+  HOST_WIDE_INT bits;
+  rtx word;
+
+  if (!CONST_INT_P (length) || MEM_ALIGN (dest) < BITS_PER_WORD)
+    return false;
+  if (INTVAL (length) > RISCV_MAX_MOVE_BYTES_STRAIGHT
+      && (!optimize || INTVAL (length) > tune_info->block_inline_max))
+    return false;
+
+  /* Replicate the byte over a word.  */
+  if (CONST_INT_P (value))
+    {
+      HOST_WIDE_INT v = INTVAL (value) & 0xff;
+
+      word = v ? force_reg (word_mode, gen_int_mode (v * (~(unsigned HOST_WIDE_INT) 0 / 0xff), word_mode))
+	       : const0_rtx;
+    }
+  else
+    {
+      word = convert_to_mode (word_mode, value, 1);
+      for (bits = BITS_PER_UNIT; bits < BITS_PER_WORD; bits *= 2)
+	word = expand_simple_binop (word_mode, IOR, word,
+				    expand_simple_binop (word_mode, ASHIFT, word, GEN_INT (bits),
+							 NULL_RTX, 1, OPTAB_WIDEN),
+				    NULL_RTX, 1, OPTAB_WIDEN);
+      word = force_reg (word_mode, word);
+    }
+
+  /* With RISCV_MAX_MOVE_BYTES_STRAIGHT per iteration riscv_block_op_loop
+     iterates at most once, i.e. emits no loop.  */
+  riscv_block_op_loop (dest, NULL_RTX, word, INTVAL (length),
+		       INTVAL (length) <= RISCV_MAX_MOVE_BYTES_STRAIGHT
+		       ? RISCV_MAX_MOVE_BYTES_STRAIGHT : RISCV_MAX_MOVE_BYTES_PER_LOOP_ITER);
+  return true;
+}
+
+/* Highest interrupt line that interrupt(N) can put a handler on.  */
+#define RISCV_IT_VECTOR_MAX 31
+
+/* Return true if ARG is a valid interrupt line for interrupt(N).  */
+
+static bool
+riscv_valid_interrupt_line_p (tree arg)
+{
+  return TREE_CODE (arg) == INTEGER_CST && tree_fits_uhwi_p (arg)
+	 && tree_to_uhwi (arg) <= RISCV_IT_VECTOR_MAX;
+}
+
+/* Handle the optional interrupt line N of an interrupt(N) attribute. A bad
+   line is an error but the attribute is kept, the function is still an
+   interrupt handler, it only gets no vector entry.  */
+
+static tree
+riscv_handle_interrupt_attribute (tree *node ATTRIBUTE_UNUSED, tree name, tree args,
+				  int flags ATTRIBUTE_UNUSED, bool *no_add_attrs ATTRIBUTE_UNUSED)
+{
+  if (args && !riscv_valid_interrupt_line_p (TREE_VALUE (args)))
+    error ("%qE attribute argument must be an interrupt line between 0 and %d",
+	   name, RISCV_IT_VECTOR_MAX);
+  return NULL_TREE;
+}
+
+/* Return the interrupt line given to the interrupt attribute of function
+   DECL, -1 if there is none.  */
+
+static int
+riscv_interrupt_vector (tree decl)
+{
+  static const char *const names[] = { "interrupt", "Uinterrupt", "Sinterrupt", "Hinterrupt", "Minterrupt" };
+  tree attrs = TYPE_ATTRIBUTES (TREE_TYPE (decl));
+  unsigned i;
+
+  for (i = 0; i < ARRAY_SIZE (names); i++)
+    {
+      tree attr = lookup_attribute (names[i], attrs);
+
+      if (attr && TREE_VALUE (attr)
+	  && riscv_valid_interrupt_line_p (TREE_VALUE (TREE_VALUE (attr))))
+	return tree_to_uhwi (TREE_VALUE (TREE_VALUE (attr)));
+    }
+  return -1;
+}
+
+/* Implement TARGET_ASM_FUNCTION_EPILOGUE.  An interrupt(N) handler gets its
+   vector entry, a direct jump in section .vectors.N that the linker script
+   places at the vector base + 4 * N, see libgloss riscv/pulp-vectors.ld.
+   The jump is kept uncompressed so that every entry is 4 bytes.  The
+   __riscv_vector_N symbol makes two handlers on the same line a link
+   error.  */
+
+static void
+riscv_output_function_epilogue (FILE *file, HOST_WIDE_INT size ATTRIBUTE_UNUSED)
+{
+  const char *fnname;
+  int vector;
+
+  if (!cfun->machine->is_interrupt) return;
+  vector = riscv_interrupt_vector (current_function_decl);
+  if (vector < 0) return;
+
+  fnname = XSTR (XEXP (DECL_RTL (current_function_decl), 0), 0);
+  fprintf (file, "\t.pushsection\t.vectors.%d,\"ax\",@progbits\n", vector);
+  fprintf (file, "\t.option\tpush\n\t.option\tnorvc\n");
+  fprintf (file, "\t.globl\t__riscv_vector_%d\n", vector);
+  fprintf (file, "__riscv_vector_%d:\n", vector);
+  fprintf (file, "\tj\t");
+  assemble_name (file, fnname);
+  fprintf (file, "\n\t.option\tpop\n\t.popsection\n");
+}
+
 static const struct attribute_spec riscv_attribute_table[] =
 {
   /* { name, min_len, max_len, decl_req, type_req, fn_type_req, handler } */
-  { "interrupt",      0, 0, false, true,  true,  NULL, true  },
-  { "Uinterrupt",     0, 0, false, true,  true,  NULL, true  },
-  { "Sinterrupt",     0, 0, false, true,  true,  NULL, true  },
-  { "Hinterrupt",     0, 0, false, true,  true,  NULL, true  },
-  { "Minterrupt",     0, 0, false, true,  true,  NULL, true  },
+  { "interrupt",      0, 1, false, true,  true,  riscv_handle_interrupt_attribute, true  },
+  { "Uinterrupt",     0, 1, false, true,  true,  riscv_handle_interrupt_attribute, true  },
+  { "Sinterrupt",     0, 1, false, true,  true,  riscv_handle_interrupt_attribute, true  },
+  { "Hinterrupt",     0, 1, false, true,  true,  riscv_handle_interrupt_attribute, true  },
+  { "Minterrupt",     0, 1, false, true,  true,  riscv_handle_interrupt_attribute, true  },
   { "tiny",           0, 0, true,  false, false, NULL, true  },
   { "import",         0, 0, false, true,  true,  NULL, true  },
   { "import_var",     0, 0, true,  false, false, NULL, true  },
@@ -3789,17 +5368,42 @@ static int scan_reg_definitions(int regno)
 
 }
 
-/* Return true if the current function must save register REGNO.  */
+/* Set *SET to the registers that the calls made by the current function
+   may clobber.  With -fipa-ra a callee of this unit that is already compiled
+   gives the registers it really writes, any other callee is assumed to
+   write all the call clobbered registers.  */
+
+static void
+riscv_calls_clobbered_regs (HARD_REG_SET *set)
+{
+  rtx_insn *insn;
+
+  CLEAR_HARD_REG_SET (*set);
+  for (insn = get_insns (); insn; insn = NEXT_INSN (insn))
+    if (CALL_P (insn))
+      {
+	HARD_REG_SET used;
+
+	get_call_reg_set_usage (insn, &used, regs_invalidated_by_call);
+	IOR_HARD_REG_SET (*set, used);
+      }
+  AND_COMPL_HARD_REG_SET (*set, fixed_reg_set);
+}
+
+/* Return true if the current function must save register REGNO.  An
+   interrupt handler has no call clobbered registers, it saves the ones it
+   writes and CALL_CLOBBERED, the ones its callees write.  */
 
 static bool
-riscv_save_reg_p (unsigned int regno, unsigned int is_it)
+riscv_save_reg_p (unsigned int regno, unsigned int is_it, HARD_REG_SET call_clobbered)
 {
   bool call_saved = !global_regs[regno] && !call_really_used_regs[regno];
   bool might_clobber = crtl->saves_all_registers
 		       || df_regs_ever_live_p (regno)
 		       || (regno == HARD_FRAME_POINTER_REGNUM
 			   && frame_pointer_needed);
-  bool it_rel = is_it && df_regs_ever_live_p(regno) && scan_reg_definitions(regno);
+  bool it_rel = is_it && ((df_regs_ever_live_p(regno) && scan_reg_definitions(regno))
+			  || TEST_HARD_REG_BIT (call_clobbered, regno));
 
   return (call_saved && might_clobber)
 	 || (regno == RETURN_ADDR_REGNUM && crtl->calls_eh_return)
@@ -3874,7 +5478,8 @@ riscv_compute_frame_info (void)
 {
   struct riscv_frame_info *frame;
   HOST_WIDE_INT offset;
-  unsigned int regno, i, num_x_saved = 0, num_f_saved = 0;
+  unsigned int regno, i, num_x_saved = 0, num_f_saved = 0, num_hwloop_saved = 0;
+  HARD_REG_SET call_clobbered;
   static bool Trace=false;
 
   frame = &cfun->machine->frame;
@@ -3883,9 +5488,16 @@ riscv_compute_frame_info (void)
   if (Trace) fprintf(stderr, "- %30s ----FRAME INFOS---------------------\n", current_function_name());
 
   if (Trace) fprintf(stderr, "Setting up frame info, is_it: %s (%X)\n", frame->is_it?"Yes":"No", frame->is_it);
+  CLEAR_HARD_REG_SET (call_clobbered);
+  if (frame->is_it) {
+    riscv_calls_clobbered_regs (&call_clobbered);
+    frame->hwloop_levels = riscv_interrupt_hwloop_levels ();
+    num_hwloop_saved = 3 * popcount_hwi (frame->hwloop_levels);
+  }
   /* Find out which GPRs we need to save.  */
   for (regno = GP_REG_FIRST; regno <= GP_REG_LAST; regno++)
-    if (riscv_save_reg_p (regno, frame->is_it)) {
+    if (riscv_save_reg_p (regno, frame->is_it, call_clobbered)
+	|| (num_hwloop_saved && regno == RISCV_PROLOGUE_TEMP_REGNUM)) {
       frame->mask |= 1 << (regno - GP_REG_FIRST), num_x_saved++;
       if (Trace)
                 fprintf(stderr, "\tGGGr%3d [%5s]: Lives:%3s, Call Used: %3s, Call Really Used:%3s, Invalidated:%3s, Def Cnt=%3d\n",
@@ -3913,7 +5525,7 @@ riscv_compute_frame_info (void)
      the same space as its companion in riscv_for_each_saved_gpr_and_fpr.  */
   if (TARGET_HARD_FLOAT)
     for (regno = FP_REG_FIRST; regno <= FP_REG_LAST; regno++)
-      if (riscv_save_reg_p (regno, frame->is_it)) {
+      if (riscv_save_reg_p (regno, frame->is_it, call_clobbered)) {
         frame->fmask |= 1 << (regno - FP_REG_FIRST), num_f_saved++;
       if (Trace)
                 fprintf(stderr, "\tFFFr%3d [%5s]: Lives:%3s, Call Used: %3s, Call Really Used:%3s, Invalidated:%3s, Def Cnt=%3d\n",
@@ -3931,6 +5543,13 @@ riscv_compute_frame_info (void)
   /* The virtual frame pointer points above the local variables. */
   frame->frame_pointer_offset = offset;
   if (Trace) fprintf(stderr, "After align, FP off: %d\n", (int) offset);
+  /* Next are the hardware loop registers saved by an interrupt handler. */
+  if (num_hwloop_saved)
+    {
+      offset += RISCV_STACK_ALIGN (num_hwloop_saved * UNITS_PER_WORD);
+      frame->hwloop_sp_offset = offset - UNITS_PER_WORD;
+      if (Trace) fprintf(stderr, "hwloop_sp_offset: %d\n", (int) frame->hwloop_sp_offset);
+    }
   /* Next are the callee-saved FPRs. */
   if (frame->fmask)
     {
@@ -4069,6 +5688,7 @@ static void
 riscv_for_each_saved_gpr_and_fpr (HOST_WIDE_INT sp_offset,
 				 riscv_save_restore_fn fn)
 {
+  enum machine_mode fmode = TARGET_SINGLE_FLOAT ? SFmode : DFmode;
   HOST_WIDE_INT offset;
   int regno;
 
@@ -4087,11 +5707,51 @@ riscv_for_each_saved_gpr_and_fpr (HOST_WIDE_INT sp_offset,
   for (regno = FP_REG_FIRST; regno <= FP_REG_LAST; regno++)
     if (BITSET_P (cfun->machine->frame.fmask, regno - FP_REG_FIRST))
       {
-	riscv_save_restore_reg (DFmode, regno, offset, fn);
-	offset -= GET_MODE_SIZE (DFmode);
+	riscv_save_restore_reg (fmode, regno, offset, fn);
+	offset -= GET_MODE_SIZE (fmode);
       }
 }
 
+/* CSR numbers of the start, end and count registers of hardware loop
+   level 0, the ones of level 1 follow 4 entries further.  */
+#define RISCV_CSR_LPSTART0 0x7b0
+#define RISCV_CSR_LPEND0   0x7b1
+#define RISCV_CSR_LPCOUNT0 0x7b2
+
+/* Save (SAVE_P) or restore the hardware loop registers of the levels in
+   the interrupt handler frame, through the prologue temporary.  SP_OFFSET
+   is the offset of the current stack pointer from the start of the frame.  */
+
+static void
+riscv_save_restore_hwloops (HOST_WIDE_INT sp_offset, bool save_p)
+{
+  static const int csr[] = { RISCV_CSR_LPSTART0, RISCV_CSR_LPEND0, RISCV_CSR_LPCOUNT0 };
+  rtx temp = RISCV_PROLOGUE_TEMP (SImode);
+  HOST_WIDE_INT offset;
+  unsigned level, i;
+
+  offset = cfun->machine->frame.hwloop_sp_offset - sp_offset;
+  for (level = 0; level < 2; level++)
+    if (cfun->machine->frame.hwloop_levels & (1 << level))
+      for (i = 0; i < ARRAY_SIZE (csr); i++)
+	{
+	  rtx spr = GEN_INT (csr[i] + 4 * level);
+	  rtx mem = gen_frame_mem (SImode, plus_constant (Pmode, stack_pointer_rtx, offset));
+
+	  if (save_p)
+	    {
+	      emit_insn (gen_read_spr_vol (temp, spr));
+	      riscv_emit_move (mem, temp);
+	    }
+	  else
+	    {
+	      riscv_emit_move (temp, mem);
+	      emit_insn (gen_write_spr (spr, temp));
+	    }
+	  offset -= UNITS_PER_WORD;
+	}
+}
+
 /* Emit a move from SRC to DEST, given that one of them is a register
    save slot and that the other is a register.  TEMP is a temporary
    GPR of the same mode that is available if need be.  */
@@ -4211,6 +5871,13 @@ riscv_expand_prologue (void)
       RTX_FRAME_RELATED_P (emit_insn (insn)) = 1;
       size -= step1;
       riscv_for_each_saved_gpr_and_fpr (size, riscv_save_reg);
+      if (frame->hwloop_levels)
+	{
+	  if (Pulp_Cpu < PULP_V2)
+	    error ("interrupt function contains hardware loops or calls that may use them: %s",
+		   current_function_name());
+	  riscv_save_restore_hwloops (size, true);
+	}
     }
 
   frame->mask = mask; /* Undo the above fib.  */
@@ -4327,18 +5994,6 @@ riscv_set_current_function (tree decl)
 }
 
 
-static bool riscv_current_func_contains_call()
-
-{
-	rtx_insn *first = entry_of_function();
-	rtx_insn *insn;
-
-	for (insn = next_active_insn (first); insn; insn = next_active_insn (insn)) {
-		if (CALL_P (insn)) return true;
-	}
-	return false;
-}
-
 /* Expand an "epilogue" or "sibcall_epilogue" pattern; SIBCALL_P
    says which.  */
 
@@ -4357,16 +6012,6 @@ riscv_expand_epilogue (bool sibcall_p)
   bool use_restore_libcall = !sibcall_p && riscv_use_save_libcall (frame);
   rtx ra = gen_rtx_REG (Pmode, RETURN_ADDR_REGNUM);
 
-  if (cfun->machine->is_interrupt) {
-	if (cfun->machine->has_hardware_loops) {
-    		error ("interrupt function contains hardware loop: %s", current_function_name());
-	}
-	cfun->machine->contains_call = (!TARGET_MASK_NOHWLOOP && riscv_current_func_contains_call());
-	if (cfun->machine->contains_call) {
-    		error ("interrupt function contains function calls: %s", current_function_name());
-	}
-  }
-
   if (!sibcall_p && riscv_can_use_return_insn ())
     {
       if (frame->is_it) {
@@ -4418,7 +6063,10 @@ riscv_expand_epilogue (bool sibcall_p)
   if (use_restore_libcall)
     frame->mask = 0; /* Temporarily fib that we need not save GPRs.  */
 
-  /* Restore the registers.  */
+  /* Restore the registers, the hw loop ones first since they go through
+     a saved GPR.  */
+  if (frame->hwloop_levels)
+    riscv_save_restore_hwloops (frame->total_size - step2, false);
   riscv_for_each_saved_gpr_and_fpr (frame->total_size - step2,
 				    riscv_restore_reg);
 
@@ -4490,6 +6138,10 @@ riscv_hard_regno_mode_ok_p (unsigned int regno, enum machine_mode mode)
   unsigned int size = GET_MODE_SIZE (mode);
   enum mode_class mclass = GET_MODE_CLASS (mode);
 
+  /* Two word vectors live in an even/odd GPR pair, like DImode.  */
+  if (VECTOR_MODE_P (mode) && size > UNITS_PER_WORD)
+    return GP_REG_P (regno) && regno % 2 == 0;
+
   /* This is hella bogus but ira_build segfaults on RV32 without it. */
   if (VECTOR_MODE_P (mode))
     return true;
@@ -4506,9 +6158,10 @@ riscv_hard_regno_mode_ok_p (unsigned int regno, enum machine_mode mode)
 
   if (FP_REG_P (regno))
     {
-      if (mclass == MODE_FLOAT
-	  || mclass == MODE_COMPLEX_FLOAT
-	  || mclass == MODE_VECTOR_FLOAT)
+      if ((mclass == MODE_FLOAT
+	   || mclass == MODE_COMPLEX_FLOAT
+	   || mclass == MODE_VECTOR_FLOAT)
+	  && !riscv_small_float_mode_p (mode))
 	return size <= UNITS_PER_FPVALUE;
     }
 
@@ -4641,25 +6294,130 @@ riscv_secondary_reload_class (enum reg_class rclass,
 	/* We can use fmv.fmt. */
 	return NO_REGS;
 
-      /* Otherwise, we need to reload through an integer register.  */
-      return GR_REGS;
-    }
-  if (FP_REG_P (regno))
-    return reg_class_subset_p (rclass, GR_REGS) ? NO_REGS : GR_REGS;
+      /* Otherwise, we need to reload through an integer register.  */
+      return GR_REGS;
+    }
+  if (FP_REG_P (regno))
+    return reg_class_subset_p (rclass, GR_REGS) ? NO_REGS : GR_REGS;
+
+  return NO_REGS;
+}
+
+/* Implement TARGET_MODE_REP_EXTENDED.  */
+
+static int
+riscv_mode_rep_extended (enum machine_mode mode, enum machine_mode mode_rep)
+{
+  /* On 64-bit targets, SImode register values are sign-extended to DImode.  */
+  if (TARGET_64BIT && mode == SImode && mode_rep == DImode)
+    return SIGN_EXTEND;
+
+  return UNKNOWN;
+}
+
+/* __fp8 is stored as the upper byte of an IEEE half, encode and decode
+   it through the half format once rounded to its 3 bit precision.  */
+
+static void
+encode_riscv_fp8 (const struct real_format *fmt ATTRIBUTE_UNUSED,
+		  long *buf, const REAL_VALUE_TYPE *r)
+{
+  long half;
+
+  real_to_target_fmt (&half, r, &ieee_half_format);
+  buf[0] = (half >> 8) & 0xff;
+}
+
+static void
+decode_riscv_fp8 (const struct real_format *fmt ATTRIBUTE_UNUSED,
+		  REAL_VALUE_TYPE *r, const long *buf)
+{
+  long half = (buf[0] & 0xff) << 8;
+
+  real_from_target_fmt (r, &half, &ieee_half_format);
+}
+
+const struct real_format riscv_fp8_format =
+  {
+    encode_riscv_fp8,
+    decode_riscv_fp8,
+    2,
+    3,
+    3,
+    -13,
+    16,
+    7,
+    7,
+    false,
+    true,
+    true,
+    true,
+    true,
+    true,
+    true,
+    false
+  };
+
+/* Return true if MODE is __fp16/__fp8 based.  There is no FPU support
+   for them, such values are kept and passed in GPRs.  */
+
+static bool
+riscv_small_float_mode_p (enum machine_mode mode)
+{
+  return (FLOAT_MODE_P (mode) && GET_MODE_UNIT_SIZE (mode) < 4);
+}
+
+/* Return true if TYPE is __fp16 or __fp8.  */
+
+static bool
+riscv_small_float_type_p (const_tree type)
+{
+  if (type == NULL_TREE)
+    return false;
+  type = TYPE_MAIN_VARIANT (type);
+  return (type == riscv_fp16_type_node || type == riscv_fp8_type_node);
+}
+
+/* Implement TARGET_PROMOTED_TYPE.  __fp16 and __fp8 are storage formats,
+   arithmetic on them is done in float.  */
 
-  return NO_REGS;
+static tree
+riscv_promoted_type (const_tree t)
+{
+  if (riscv_small_float_type_p (t))
+    return float_type_node;
+  return NULL_TREE;
 }
 
-/* Implement TARGET_MODE_REP_EXTENDED.  */
+/* Implement TARGET_CONVERT_TO_TYPE.  libgcc only converts __fp16 and __fp8
+   from and to float, go through float for any other scalar type.  */
 
-static int
-riscv_mode_rep_extended (enum machine_mode mode, enum machine_mode mode_rep)
+static tree
+riscv_convert_to_type (tree type, tree expr)
 {
-  /* On 64-bit targets, SImode register values are sign-extended to DImode.  */
-  if (TARGET_64BIT && mode == SImode && mode_rep == DImode)
-    return SIGN_EXTEND;
+  tree fromtype = TREE_TYPE (expr);
 
-  return UNKNOWN;
+  if (!riscv_small_float_type_p (fromtype) && !riscv_small_float_type_p (type))
+    return NULL_TREE;
+  if (TYPE_MAIN_VARIANT (fromtype) == float_type_node
+      || TYPE_MAIN_VARIANT (type) == float_type_node)
+    return NULL_TREE;
+  if (!(SCALAR_FLOAT_TYPE_P (fromtype) || INTEGRAL_TYPE_P (fromtype))
+      || !(SCALAR_FLOAT_TYPE_P (type) || INTEGRAL_TYPE_P (type)))
+    return NULL_TREE;
+  return convert (type, convert (float_type_node, expr));
+}
+
+/* Implement TARGET_MANGLE_TYPE.  */
+
+static const char *
+riscv_mangle_type (const_tree type)
+{
+  if (TREE_CODE (type) == REAL_TYPE && TYPE_MAIN_VARIANT (type) == riscv_fp16_type_node)
+    return "Dh";
+  if (TREE_CODE (type) == REAL_TYPE && TYPE_MAIN_VARIANT (type) == riscv_fp8_type_node)
+    return "u5__fp8";
+  return NULL;
 }
 
 /* Implement TARGET_SCALAR_MODE_SUPPORTED_P.  */
@@ -4671,6 +6429,9 @@ riscv_scalar_mode_supported_p (enum machine_mode mode)
       && GET_MODE_PRECISION (mode) <= 2 * BITS_PER_WORD)
     return true;
 
+  if (mode == HFmode || mode == QFmode)
+    return true;
+
   return default_scalar_mode_supported_p (mode);
 }
 
@@ -5156,24 +6917,135 @@ static int Head_Remapped_GOMP_Builtins=0;
 enum Riscv_Native_GOMP_Builtins {
 	NATIVE_GOMP_LOOP_CHUNK_SIZE = 0,
 	NATIVE_GOMP_LOOP_START = 1,
-	NATIVE_GOMP_LAST = 2
+	NATIVE_GOMP_REDUCTION = 2,
+	NATIVE_GOMP_CRITICAL_NAME = 3,
+	NATIVE_GOMP_LAST = 4
 };
 
+/* Reduction slots when -mPE is not given, larger teams use the generic reduction */
+#define NATIVE_GOMP_MAX_CORES 32
+
 static struct {
 	tree	TypeDescr;
-	int	Base;
-	int 	Index;
+	enum riscv_evt_unit_reg Reg;
 } Native_GOMP_Builtins[NATIVE_GOMP_LAST] = 
 {
-	{NULL, 0x00204000, 0x70},		// OMP Loop Chunk Size
-	{NULL, 0x00204000, 0x64},		// OMP Loop Start
+	{NULL, EVT_UNIT_LOOP_CHUNK},		// OMP Loop Chunk Size
+	{NULL, EVT_UNIT_LOOP_START},		// OMP Loop Start
+	{NULL, EVT_UNIT_LAST},			// Reduction, slots indexed by thread num. Not an event unit register
+	{NULL, EVT_UNIT_MUTEX},			// Named critical, lock is a hardware mutex
+};
+
+/* Cluster event unit seen by the native OpenMP lowering: its base address
+   and the offsets of its registers.  */
+struct riscv_evt_unit_map {
+	HOST_WIDE_INT Base;
+	int Offset[EVT_UNIT_LAST];
 };
 
+/* Event unit of each -mchip, in the order of enum Pulp_Chip_Type.  */
+static const struct riscv_evt_unit_map Pulp_Chip_Evt_Unit[PULP_CHIP_LAST] = {
+/* None */	{0x00204000, {0x21c, 0xc0, 0x64, 0x70}},
+/* Honey */	{0x00204000, {0x21c, 0xc0, 0x64, 0x70}},
+/* Pulpino */	{0x00204000, {0x21c, 0xc0, 0x64, 0x70}},
+};
+
+/* Event unit of this compilation, from -mchip then -mchip-desc.  */
+static struct riscv_evt_unit_map Evt_Unit;
+
+/* Read the event unit description FILE into Evt_Unit. It is made of KEY=VALUE
+   pairs separated by white space, # starts a comment up to the end of the line.
+   Keys are evt_base, evt_barrier, evt_mutex, evt_loop_start and evt_loop_chunk,
+   values are C integer constants, missing keys keep their -mchip value.  */
+
+static void
+riscv_read_chip_desc (const char *file)
+{
+	static const char *const Keys[EVT_UNIT_LAST] = {"evt_barrier", "evt_mutex", "evt_loop_start", "evt_loop_chunk"};
+	FILE *f = fopen (file, "r");
+	char Line[256];
+	int LineNo = 0;
+
+	if (!f) {
+		error ("cannot open chip description file %s: %m", file);
+		return;
+	}
+	while (fgets (Line, sizeof (Line), f)) {
+		char *Tok, *Comment = strchr (Line, '#');
+
+		LineNo++;
+		if (Comment) *Comment = 0;
+		for (Tok = strtok (Line, " \t\r\n"); Tok; Tok = strtok (NULL, " \t\r\n")) {
+			char *Value = strchr (Tok, '='), *End;
+			HOST_WIDE_INT Val;
+			int i;
+
+			if (Value) *Value++ = 0;
+			Val = Value ? strtol (Value, &End, 0) : 0;
+			if (!Value || *Value == 0 || *End != 0) {
+				error ("%s:%d: expected KEY=VALUE, found %qs", file, LineNo, Tok);
+				continue;
+			}
+			if (strcmp (Tok, "evt_base") == 0) {
+				Evt_Unit.Base = Val; continue;
+			}
+			for (i = 0; i < EVT_UNIT_LAST; i++)
+				if (strcmp (Tok, Keys[i]) == 0) break;
+			if (i == EVT_UNIT_LAST)
+				error ("%s:%d: unknown chip description key %qs", file, LineNo, Tok);
+			else if (!SMALL_OPERAND (Val))
+				error ("%s:%d: %qs offset %d is not a 12 bit signed immediate", file, LineNo, Tok, (int) Val);
+			else Evt_Unit.Offset[i] = Val;
+		}
+	}
+	fclose (f);
+}
+
+/* Return a register holding the event unit base when BASE is NULL_RTX or the
+   event unit base itself, otherwise BASE in a register. While expanding it is a
+   single pseudo per function set up on function entry, it then lives in a
+   callee saved register across the function rather than being rebuilt with
+   lui/addi at each use.  */
+
+rtx
+riscv_evt_unit_base (rtx base)
+{
+	rtx_insn *Seq;
+
+	if (base && !(CONST_INT_P (base) && INTVAL (base) == trunc_int_for_mode (Evt_Unit.Base, SImode)))
+		return force_reg (SImode, base);
+	if (!currently_expanding_to_rtl) return force_reg (SImode, gen_int_mode (Evt_Unit.Base, SImode));
+
+	if (!cfun->machine->evt_unit_base) {
+		cfun->machine->evt_unit_base = gen_reg_rtx (SImode);
+		start_sequence ();
+		riscv_emit_move (cfun->machine->evt_unit_base, gen_int_mode (Evt_Unit.Base, SImode));
+		Seq = get_insns ();
+		end_sequence ();
+		/* Builtins can be expanded with PHI nodes, queue the set up on the entry
+		   edge, it is committed once the whole function is expanded.  */
+		insert_insn_on_edge (Seq, single_succ_edge (ENTRY_BLOCK_PTR_FOR_FN (cfun)));
+	}
+	return cfun->machine->evt_unit_base;
+}
+
+/* Return the offset of event unit register REG from the event unit base.  */
+
+int
+riscv_evt_unit_offset (enum riscv_evt_unit_reg reg)
+{
+	return Evt_Unit.Offset[reg];
+}
+
 unsigned int GetRemappedGompBuiltin(unsigned int ompcode, unsigned int def_ret)
 
 {
 	int i;
 
+	/* Named critical locks are hardware mutexes only where omp-low places them
+	   in .evt_mutex, otherwise they stay libgomp calls on a common lock.  */
+	if ((ompcode == BUILT_IN_GOMP_CRITICAL_NAME_START || ompcode == BUILT_IN_GOMP_CRITICAL_NAME_END) &&
+	    !riscv_omp_target_decl (NATIVE_GOMP_CRITICAL_NAME, NULL, NULL)) return def_ret;
 	for (i=0; i<Head_Remapped_GOMP_Builtins; i++) {
 		if (Remapped_GOMP_Builtins[i].Gomp == ompcode) return Remapped_GOMP_Builtins[i].Pulp;
 	}
@@ -5211,15 +7083,14 @@ riscv_init_builtins (void)
 {
   const struct riscv_builtin_description *d;
   unsigned int i;
-/*
-  tree fp16_type = make_node (REAL_TYPE);
-  tree fp8_type = make_node (REAL_TYPE);
 
-  TYPE_PRECISION (fp16_type) = 16; TYPE_PRECISION (fp8_type) = 8;
-  layout_type (fp16_type); layout_type (fp8_type);
-  (*lang_hooks.types.register_builtin_type) (fp16_type, "__fp16");
-  (*lang_hooks.types.register_builtin_type) (fp8_type, "__fp8");
-*/
+  riscv_fp16_type_node = make_node (REAL_TYPE);
+  riscv_fp8_type_node = make_node (REAL_TYPE);
+
+  TYPE_PRECISION (riscv_fp16_type_node) = 16; TYPE_PRECISION (riscv_fp8_type_node) = 8;
+  layout_type (riscv_fp16_type_node); layout_type (riscv_fp8_type_node);
+  (*lang_hooks.types.register_builtin_type) (riscv_fp16_type_node, "__fp16");
+  (*lang_hooks.types.register_builtin_type) (riscv_fp8_type_node, "__fp8");
 
   opaque_V4QI_type_node    = build_opaque_vector_type (intQI_type_node, 4);
   opaque_V2HI_type_node    = build_opaque_vector_type (intHI_type_node, 2);
@@ -5250,6 +7121,17 @@ riscv_init_builtins (void)
 				Remapped_GOMP_Builtins[Head_Remapped_GOMP_Builtins].Pulp = i;
 				Head_Remapped_GOMP_Builtins++;
 				break;
+			case CODE_FOR_pulp_omp_critical_name_start:
+				Remapped_GOMP_Builtins[Head_Remapped_GOMP_Builtins].Gomp = BUILT_IN_GOMP_CRITICAL_NAME_START;
+				Remapped_GOMP_Builtins[Head_Remapped_GOMP_Builtins].Pulp = i;
+				Head_Remapped_GOMP_Builtins++;
+				Native_GOMP_Builtins[NATIVE_GOMP_CRITICAL_NAME].TypeDescr = riscv_builtin_decls[i];
+				break;
+			case CODE_FOR_pulp_omp_critical_name_end:
+				Remapped_GOMP_Builtins[Head_Remapped_GOMP_Builtins].Gomp = BUILT_IN_GOMP_CRITICAL_NAME_END;
+				Remapped_GOMP_Builtins[Head_Remapped_GOMP_Builtins].Pulp = i;
+				Head_Remapped_GOMP_Builtins++;
+				break;
 			case CODE_FOR_OffsetedReadOMP:
 				Native_GOMP_Builtins[NATIVE_GOMP_LOOP_CHUNK_SIZE].TypeDescr = riscv_builtin_decls[i];
 				Native_GOMP_Builtins[NATIVE_GOMP_LOOP_START].TypeDescr = riscv_builtin_decls[i];
@@ -5503,8 +7385,17 @@ riscv_omp_target_decl(int t_omp_code, int *Base, int *Index)
 
 
 	if (t_omp_code < 0 || t_omp_code >= NATIVE_GOMP_LAST) return NULL;
-	if (Base) *Base = Native_GOMP_Builtins[t_omp_code].Base;
-	if (Index) *Index = Native_GOMP_Builtins[t_omp_code].Index;
+	if (Native_GOMP_Builtins[t_omp_code].Reg == EVT_UNIT_LAST) {
+		/* Not an event unit register, Index is the number of per thread slots */
+		if (Base) *Base = 0;
+		if (Index) *Index = (_Pulp_PE > 0) ? _Pulp_PE : NATIVE_GOMP_MAX_CORES;
+		return builtin_decl_explicit (BUILT_IN_OMP_GET_THREAD_NUM);
+	}
+	if (Evt_Unit.Offset[Native_GOMP_Builtins[t_omp_code].Reg] == -1) return NULL;
+	/* Named critical needs .evt_mutex to be mapped by the link script, opt in */
+	if (t_omp_code == NATIVE_GOMP_CRITICAL_NAME && !TARGET_MASK_NATIVE_CRITICAL) return NULL;
+	if (Base) *Base = Evt_Unit.Base;
+	if (Index) *Index = Evt_Unit.Offset[Native_GOMP_Builtins[t_omp_code].Reg];
 	return (Native_GOMP_Builtins[t_omp_code].TypeDescr);
 }
 
@@ -5659,10 +7550,17 @@ riscv_option_override (void)
   if (optimize_size && (target_flags_explicit & MASK_MEMCPY) == 0)
     target_flags |= MASK_MEMCPY;
 
-  /* Handle -mtune.  */
+  /* Handle -mtune, without it pulp cores are tuned for the core implementing
+     the -march pulp extension.  */
+  if (!riscv_tune_string)
+    {
+      if (Pulp_Cpu == PULP_SLIM) riscv_tune_string = "pulpslim";
+      else if (Pulp_Cpu >= PULP_V0) riscv_tune_string = "riscy";
+    }
   cpu = riscv_parse_cpu (riscv_tune_string ? riscv_tune_string :
 			 RISCV_TUNE_STRING_DEFAULT);
   tune_info = optimize_size ? &optimize_size_tune_info : cpu->tune_info;
+  riscv_microarchitecture = cpu->microarchitecture;
 
   /* If the user hasn't specified a branch cost, use the processor's
      default.  */
@@ -5678,6 +7576,10 @@ riscv_option_override (void)
   /* Function to allocate machine-dependent function status.  */
   init_machine_status = &riscv_init_machine_status;
 
+  /* Cluster event unit of the native OpenMP lowering.  */
+  Evt_Unit = Pulp_Chip_Evt_Unit[Pulp_Chip];
+  if (riscv_chip_desc_file) riscv_read_chip_desc (riscv_chip_desc_file);
+
   if (riscv_cmodel_string)
     {
       if (strcmp (riscv_cmodel_string, "medlow") == 0)
@@ -5691,6 +7593,10 @@ riscv_option_override (void)
   if (flag_pic)
     riscv_cmodel = CM_PIC;
   riscv_init_relocs ();
+
+  riscv_register_hwloop_info_pass ();
+  riscv_register_dot_prod_pass ();
+  riscv_register_postmod_reg_pass ();
 }
 
 /* Implement TARGET_CONDITIONAL_REGISTER_USAGE.  */
@@ -5835,11 +7741,432 @@ bool riscv_filter_pulp_operand(rtx x, bool ignore)
 /* Maximum distance of the LSETUP instruction from the loop start.  */
 #define MAX_LSETUP_DISTANCE 30
 
+/* Hardware loop levels whose LC/LS/LE registers are written by a
+   function, bit 0 for LC0/LS0/LE0 and bit 1 for LC1/LS1/LE1.  */
+#define HWLOOP_LEVEL0 0x1
+#define HWLOOP_LEVEL1 0x2
+#define HWLOOP_LEVEL_ALL (HWLOOP_LEVEL0 | HWLOOP_LEVEL1)
+
+/* Hardware loop levels written by each function already compiled in this
+   unit, including the ones written by its own callees. Functions are
+   expanded callees first so this is usually known when a caller reaches
+   the doloop pass.  */
+static hash_map<tree, unsigned> *riscv_hwloop_fn_levels;
+
+/* Level given by hwloop_optimize to each loop of the current function,
+   indexed by loop_no, 0 when the loop was not turned into a hw loop.  */
+static vec<unsigned> riscv_hwloop_loop_levels;
+
+static unsigned
+riscv_hwloop_levels_in_set (HARD_REG_SET set)
+{
+  unsigned levels = 0;
+
+  if (TEST_HARD_REG_BIT (set, REG_LC0) || TEST_HARD_REG_BIT (set, REG_LS0) || TEST_HARD_REG_BIT (set, REG_LE0))
+    levels |= HWLOOP_LEVEL0;
+  if (TEST_HARD_REG_BIT (set, REG_LC1) || TEST_HARD_REG_BIT (set, REG_LS1) || TEST_HARD_REG_BIT (set, REG_LE1))
+    levels |= HWLOOP_LEVEL1;
+  return levels;
+}
+
+/* Return the hardware loop levels that call INSN may write. Only direct calls
+   to functions of this unit that bind locally and have already been compiled
+   are known, anything else is assumed to write both levels.  */
+static unsigned
+riscv_hwloop_call_levels (const rtx_insn *insn)
+{
+  rtx call, addr;
+  tree decl;
+  unsigned *levels;
+
+  if (TARGET_MASK_NOHWLOOPCALL || !riscv_hwloop_fn_levels) return HWLOOP_LEVEL_ALL;
+
+  call = get_call_rtx_from (CONST_CAST (rtx_insn *, insn));
+  if (!call || !MEM_P (XEXP (call, 0))) return HWLOOP_LEVEL_ALL;
+  addr = XEXP (XEXP (call, 0), 0);
+  if (GET_CODE (addr) != SYMBOL_REF) return HWLOOP_LEVEL_ALL;
+
+  decl = SYMBOL_REF_DECL (addr);
+  if (!decl || TREE_CODE (decl) != FUNCTION_DECL || !targetm.binds_local_p (decl)) return HWLOOP_LEVEL_ALL;
+
+  levels = riscv_hwloop_fn_levels->get (decl);
+  return levels ? *levels : HWLOOP_LEVEL_ALL;
+}
+
+/* Return the hardware loop levels written by INSN.  */
+static unsigned
+riscv_hwloop_insn_levels (const rtx_insn *insn)
+{
+  HARD_REG_SET set;
+
+  if (CALL_P (insn)) return riscv_hwloop_call_levels (insn);
+
+  find_all_hard_reg_sets (insn, &set, false);
+  return riscv_hwloop_levels_in_set (set);
+}
+
+/* Return the hardware loop levels written inside LOOP, either directly, by a
+   callee or by an enclosed loop already turned into a hw loop.  */
+static unsigned
+riscv_hwloop_levels_set_in_loop (hwloop_info loop)
+{
+  unsigned levels = 0;
+  basic_block bb;
+  hwloop_info inner;
+  unsigned ix;
+
+  for (ix = 0; loop->blocks.iterate (ix, &bb); ix++)
+    {
+      rtx_insn *insn;
+
+      FOR_BB_INSNS (bb, insn)
+	if (NONDEBUG_INSN_P (insn)) levels |= riscv_hwloop_insn_levels (insn);
+    }
+  for (ix = 0; loop->loops.iterate (ix, &inner); ix++)
+    if ((unsigned) inner->loop_no < riscv_hwloop_loop_levels.length ())
+      levels |= riscv_hwloop_loop_levels[inner->loop_no];
+  return levels;
+}
+
+/* Record the hardware loop levels written by the current function so that
+   hw loops in its callers can be kept around calls to it.  */
+static void
+riscv_record_hwloop_levels (void)
+{
+  rtx_insn *insn;
+  unsigned levels = 0;
+
+  if (!riscv_hwloop_fn_levels) riscv_hwloop_fn_levels = new hash_map<tree, unsigned>;
+
+  for (insn = get_insns (); insn; insn = NEXT_INSN (insn))
+    if (NONDEBUG_INSN_P (insn)) levels |= riscv_hwloop_insn_levels (insn);
+
+  riscv_hwloop_fn_levels->put (current_function_decl, levels);
+}
+
+/* Return the hardware loop levels an interrupt handler must save: both
+   when it has hw loops of its own, otherwise the ones its callees write.  */
+static unsigned
+riscv_interrupt_hwloop_levels (void)
+{
+  rtx_insn *insn;
+  unsigned levels = 0;
+
+  if ((Pulp_Cpu<PULP_V1) || TARGET_MASK_NOHWLOOP) return 0;
+  if (cfun->machine->has_hardware_loops) return HWLOOP_LEVEL_ALL;
+
+  for (insn = get_insns (); insn; insn = NEXT_INSN (insn))
+    if (CALL_P (insn)) levels |= riscv_hwloop_call_levels (insn);
+  return levels;
+}
+
+/* Hardware loop selection in loop nests deeper than MAX_LOOP_DEPTH.
+
+   Each doloop candidate is weighted by the execution count of its loop end,
+   i.e. the number of counter updates and back edge branches a hw loop saves.
+   In every nest we then pick the candidates maximizing the total weight with
+   no more than MAX_LOOP_DEPTH of them nested in each other, this is a simple
+   dynamic programming on the nest tree.  */
+
+struct riscv_hwloop_cand {
+  rtx_insn *loop_end;
+  gcov_type weight;
+  int parent;
+  gcov_type best[MAX_LOOP_DEPTH + 1];
+};
+
+/* UIDs of the loop_end insns selected for a hw loop.  */
+static bitmap riscv_hwloop_selected;
+
+static gcov_type
+riscv_hwloop_subtree_best (vec<riscv_hwloop_cand> &cands, int node, int k)
+{
+  gcov_type sum = 0;
+  unsigned i;
+
+  for (i = 0; i < cands.length (); i++)
+    if (cands[i].parent == node) sum += cands[i].best[k];
+  return sum;
+}
+
+static void
+riscv_hwloop_select_subtree (vec<riscv_hwloop_cand> &cands, int node, int k)
+{
+  unsigned i;
+
+  if (k > 0 && cands[node].best[k] != riscv_hwloop_subtree_best (cands, node, k))
+    {
+      bitmap_set_bit (riscv_hwloop_selected, INSN_UID (cands[node].loop_end));
+      k--;
+    }
+  for (i = 0; i < cands.length (); i++)
+    if (cands[i].parent == node) riscv_hwloop_select_subtree (cands, i, k);
+}
+
+static void
+riscv_select_hwloops (void)
+{
+  auto_vec<riscv_hwloop_cand> cands;
+  hash_map<struct loop *, int> loop_to_cand;
+  bool use_counts = (profile_status_for_fn (cfun) == PROFILE_READ);
+  struct loop *loop;
+  rtx_insn *insn;
+  unsigned i;
+  int k;
+
+  if (riscv_hwloop_selected) BITMAP_FREE (riscv_hwloop_selected);
+  if (TARGET_MASK_NOHWLOOPSEL) return;
+
+  loop_optimizer_init (AVOID_CFG_MODIFICATIONS);
+
+  for (insn = get_insns (); insn; insn = NEXT_INSN (insn))
+    if (JUMP_P (insn) && recog_memoized (insn) == CODE_FOR_loop_end && BLOCK_FOR_INSN (insn))
+      {
+	basic_block bb = BLOCK_FOR_INSN (insn);
+	riscv_hwloop_cand c;
+
+	if (!bb->loop_father || bb->loop_father == current_loops->tree_root) continue;
+	c.loop_end = insn;
+	c.weight = use_counts ? bb->count : bb->frequency;
+	c.parent = -1;
+	loop_to_cand.put (bb->loop_father, cands.length ());
+	cands.safe_push (c);
+      }
+
+  /* Link each candidate to the closest enclosing candidate.  */
+  for (i = 0; i < cands.length (); i++)
+    for (loop = loop_outer (BLOCK_FOR_INSN (cands[i].loop_end)->loop_father);
+	 loop && loop != current_loops->tree_root; loop = loop_outer (loop))
+      {
+	int *p = loop_to_cand.get (loop);
+	if (p) { cands[i].parent = *p; break; }
+      }
+
+  loop_optimizer_finalize ();
+
+  /* Evaluate the nest trees bottom up, a candidate is ready once all its
+     children have been evaluated.  */
+  for (i = 0; i < cands.length (); i++)
+    for (k = 0; k <= MAX_LOOP_DEPTH; k++) cands[i].best[k] = -1;
+  {
+    bool changed = true;
+    while (changed)
+      {
+	changed = false;
+	for (i = 0; i < cands.length (); i++)
+	  {
+	    unsigned j;
+	    bool ready = (cands[i].best[0] < 0);
+
+	    for (j = 0; ready && j < cands.length (); j++)
+	      if (cands[j].parent == (int) i && cands[j].best[0] < 0) ready = false;
+	    if (!ready) continue;
+	    cands[i].best[0] = 0;
+	    for (k = 1; k <= MAX_LOOP_DEPTH; k++)
+	      cands[i].best[k] = MAX (riscv_hwloop_subtree_best (cands, i, k),
+				      cands[i].weight + riscv_hwloop_subtree_best (cands, i, k - 1));
+	    changed = true;
+	  }
+      }
+  }
+
+  riscv_hwloop_selected = BITMAP_ALLOC (NULL);
+  for (i = 0; i < cands.length (); i++)
+    if (cands[i].parent == -1) riscv_hwloop_select_subtree (cands, i, MAX_LOOP_DEPTH);
+
+  if (dump_file)
+    for (i = 0; i < cands.length (); i++)
+      fprintf (dump_file, ";; hw loop candidate, loop end insn %d, weight %" PRId64 ", parent %d: %s\n",
+	       INSN_UID (cands[i].loop_end), (int64_t) cands[i].weight,
+	       cands[i].parent == -1 ? -1 : (int) INSN_UID (cands[cands[i].parent].loop_end),
+	       bitmap_bit_p (riscv_hwloop_selected, INSN_UID (cands[i].loop_end)) ? "selected" : "not selected");
+}
+
+/* Return the number of edges leaving LOOP from a block other than its tail,
+   i.e. the data dependent exits taken before the iteration bound is reached.  */
+static int
+riscv_loop_early_exits (hwloop_info loop)
+{
+  basic_block bb;
+  unsigned ix;
+  int exits = 0;
+
+  for (ix = 0; loop->blocks.iterate (ix, &bb); ix++)
+    {
+      edge e;
+      edge_iterator ei;
+
+      if (bb == loop->tail) continue;
+      FOR_EACH_EDGE (e, ei, bb->succs)
+	if (!bitmap_bit_p (loop->block_bitmap, e->dest->index)) exits++;
+    }
+  return exits;
+}
+
+/* Outcome of hwloop_optimize for a doloop candidate, reported through
+   -fopt-info by the hwloopinfo pass.  */
+enum riscv_hwloop_status {
+  HWLOOP_OK,
+  HWLOOP_NOT_SELECTED,
+  HWLOOP_TOO_DEEP,
+  HWLOOP_BAD_ENTRY,
+  HWLOOP_LSETUP_PLACEMENT,
+  HWLOOP_LSETUP_TOO_FAR,
+  HWLOOP_BAD_LAYOUT,
+  HWLOOP_TOO_LONG,
+  HWLOOP_USES_ITERATOR,
+  HWLOOP_EARLY_EXIT,
+  HWLOOP_NO_LOOP_REG,
+  HWLOOP_NO_LAST_INSN,
+  HWLOOP_BAD_LAST_INSN,
+  HWLOOP_STATUS_MAX
+};
+
+static const char *riscv_hwloop_status_name[HWLOOP_STATUS_MAX] = {
+  "ok",
+  "not-selected",
+  "too-deep",
+  "bad-entry",
+  "lsetup-placement",
+  "lsetup-too-far",
+  "bad-layout",
+  "too-long",
+  "uses-iterator",
+  "early-exit",
+  "no-loop-reg",
+  "no-last-insn",
+  "bad-last-insn"
+};
+
+struct riscv_hwloop_report {
+  location_t loc;
+  int loop_no;
+  enum riscv_hwloop_status status;
+  int length;
+  int level;
+};
+
+/* Decisions taken for the loops of the current function, and counts for
+   the whole unit.  */
+static vec<riscv_hwloop_report> riscv_hwloop_reports;
+static unsigned riscv_hwloop_unit_counts[HWLOOP_STATUS_MAX];
+
+static void
+hwloop_record (hwloop_info loop, enum riscv_hwloop_status status, int level)
+{
+  riscv_hwloop_report r;
+
+  r.loc = INSN_LOCATION (loop->loop_end);
+  if (r.loc == UNKNOWN_LOCATION) r.loc = DECL_SOURCE_LOCATION (current_function_decl);
+  r.loop_no = loop->loop_no;
+  r.status = status;
+  r.length = loop->length;
+  r.level = level;
+  riscv_hwloop_reports.safe_push (r);
+  riscv_hwloop_unit_counts[status]++;
+}
+
+static bool
+hwloop_missed (hwloop_info loop, enum riscv_hwloop_status status)
+{
+  hwloop_record (loop, status, -1);
+  return false;
+}
+
+/* Emit the hw loop decisions of the current function as optimized/missed
+   remarks, they are collected during machine reorg which has no optinfo group.  */
+static unsigned int
+riscv_report_hwloops (void)
+{
+  riscv_hwloop_report *r;
+  unsigned i, created = 0;
+
+  FOR_EACH_VEC_ELT (riscv_hwloop_reports, i, r)
+    {
+      if (r->status == HWLOOP_OK)
+	{
+	  created++;
+	  if (dump_enabled_p ())
+	    dump_printf_loc (MSG_OPTIMIZED_LOCATIONS, r->loc,
+			     "hw loop %d created, level %d, length %d\n", r->loop_no, r->level, r->length);
+	}
+      else if (dump_enabled_p ())
+	dump_printf_loc (MSG_MISSED_OPTIMIZATION, r->loc,
+			 "hw loop %d not created: %s, length %d\n",
+			 r->loop_no, riscv_hwloop_status_name[r->status], r->length);
+      statistics_counter_event (cfun, riscv_hwloop_status_name[r->status], 1);
+    }
+  if (dump_enabled_p () && riscv_hwloop_reports.length ())
+    dump_printf_loc (MSG_NOTE, DECL_SOURCE_LOCATION (current_function_decl),
+		     "%u of %u hw loop candidates created in %s\n",
+		     created, riscv_hwloop_reports.length (), current_function_name ());
+  riscv_hwloop_reports.truncate (0);
+  return 0;
+}
+
+namespace {
+
+const pass_data pass_data_riscv_hwloop_info =
+{
+  RTL_PASS, /* type */
+  "hwloopinfo", /* name */
+  OPTGROUP_LOOP, /* optinfo_flags */
+  TV_NONE, /* tv_id */
+  0, /* properties_required */
+  0, /* properties_provided */
+  0, /* properties_destroyed */
+  0, /* todo_flags_start */
+  0, /* todo_flags_finish */
+};
+
+class pass_riscv_hwloop_info : public rtl_opt_pass
+{
+public:
+  pass_riscv_hwloop_info (gcc::context *ctxt)
+    : rtl_opt_pass (pass_data_riscv_hwloop_info, ctxt)
+  {}
+
+  virtual bool gate (function *) { return riscv_hwloop_reports.length () != 0; }
+  virtual unsigned int execute (function *) { return riscv_report_hwloops (); }
+};
+
+} // anon namespace
+
+/* Report hw loop decisions taken in machine reorg through -fopt-info.  */
+static void
+riscv_register_hwloop_info_pass (void)
+{
+  opt_pass *pass_hwloop_info = new pass_riscv_hwloop_info (g);
+  struct register_pass_info hwloop_info = { pass_hwloop_info, "mach", 1, PASS_POS_INSERT_AFTER };
+
+  register_pass (&hwloop_info);
+}
+
+static bool
+riscv_loop_has_call (hwloop_info loop)
+{
+  basic_block bb;
+  unsigned ix;
+
+  for (ix = 0; loop->blocks.iterate (ix, &bb); ix++)
+    {
+      rtx_insn *insn;
+
+      FOR_BB_INSNS (bb, insn)
+	if (CALL_P (insn)) return true;
+    }
+  return false;
+}
+
 static const char *
 riscv_invalid_within_doloop (const rtx_insn *insn)
 {
   if (CALL_P (insn)) {
     cfun->machine->contains_call = 1;
+    if (riscv_hwloop_call_levels (insn) != HWLOOP_LEVEL_ALL) return NULL;
+    if (dump_enabled_p ())
+      dump_printf_loc (MSG_MISSED_OPTIMIZATION, INSN_LOCATION (insn),
+		       "hw loop not possible: call to a function that may write loop registers\n");
     return "Function call in the loop.";
   }
 
@@ -5855,7 +8182,10 @@ riscv_can_use_doloop_p (const widest_int &, const widest_int &,
 {
         if ((Pulp_Cpu<PULP_V1) || TARGET_MASK_NOHWLOOP) return 0;
 
-        return (loop_depth <= 2);
+	/* Deeper loops are candidates too, riscv_select_hwloops picks in each nest the ones
+	   that will get the MAX_LOOP_DEPTH hw loop levels, the others fall back to sw loops.  */
+	if (!TARGET_MASK_NOHWLOOPSEL) return 1;
+        return (loop_depth <= MAX_LOOP_DEPTH);
 }
 
 
@@ -5893,6 +8223,7 @@ hwloop_optimize (hwloop_info loop)
   bool single_def_iter_removable = false;
   bool Padding = false;
   bool UnsafeHead = false;
+  int early_exits;
 
   if (dump_file) {
 	edge e;
@@ -5906,11 +8237,17 @@ hwloop_optimize (hwloop_info loop)
 		fprintf(dump_file, " Incoming: src= bb%4d, dest= bb%4d, Edge is: %s\n", e->src->index, e->dest->index, (e->flags & EDGE_FALLTHRU)?"Fall Through":"Branch");
 	
   }
+  if (riscv_hwloop_selected && !bitmap_bit_p (riscv_hwloop_selected, INSN_UID (loop->loop_end)))
+    {
+      if (dump_file)
+	fprintf (dump_file, ";; loop %d not selected in its nest\n", loop->loop_no);
+      return hwloop_missed (loop, HWLOOP_NOT_SELECTED);
+    }
   if (loop->depth > MAX_LOOP_DEPTH)
     {
       if (dump_file)
 	fprintf (dump_file, ";; loop %d too deep\n", loop->loop_no);
-      return false;
+      return hwloop_missed (loop, HWLOOP_TOO_DEEP);
     }
 
   /* Get the loop iteration register.  */
@@ -5921,12 +8258,12 @@ hwloop_optimize (hwloop_info loop)
   if (loop->incoming_src) {
       if (!loop->incoming_dest || (loop->incoming_dest != loop->head)) {
          if (dump_file) fprintf (dump_file, ";; loop %d no incoming_src and no incoming_dest or incoming_dest != head\n", loop->loop_no);
-         return false;
+         return hwloop_missed (loop, HWLOOP_BAD_ENTRY);
       }
   }
   if (!loop->incoming_src && (loop->incoming_dest != loop->head)) {
       if (dump_file) fprintf (dump_file, ";; loop %d no incoming_src and incoming_dest != head\n", loop->loop_no);
-      return false;
+      return hwloop_missed (loop, HWLOOP_BAD_ENTRY);
   }
   if (loop->incoming_src)
     {
@@ -5950,14 +8287,14 @@ hwloop_optimize (hwloop_info loop)
 	  if (dump_file)
 	    fprintf (dump_file, ";; loop %d lsetup not before loop_start\n",
 		     loop->loop_no);
-	  return false;
+	  return hwloop_missed (loop, HWLOOP_LSETUP_PLACEMENT);
 	}
 
       if (length > MAX_LSETUP_DISTANCE)
 	{
 	  if (dump_file)
 	    fprintf (dump_file, ";; loop %d lsetup too far away\n", loop->loop_no);
-	  return false;
+	  return hwloop_missed (loop, HWLOOP_LSETUP_TOO_FAR);
 	}
     }
 
@@ -5980,7 +8317,7 @@ hwloop_optimize (hwloop_info loop)
       if (dump_file)
 	fprintf (dump_file, ";; loop %d start_label not before loop_end\n",
 		 loop->loop_no);
-      return false;
+      return hwloop_missed (loop, HWLOOP_BAD_LAYOUT);
     }
 
   loop->length = length;
@@ -5988,7 +8325,7 @@ hwloop_optimize (hwloop_info loop)
     {
       if (dump_file)
 	fprintf (dump_file, ";; loop %d too long\n", loop->loop_no);
-      return false;
+      return hwloop_missed (loop, HWLOOP_TOO_LONG);
     }
 
   /* Scan all the blocks to make sure they don't use iter_reg.  */
@@ -5996,7 +8333,23 @@ hwloop_optimize (hwloop_info loop)
     {
       if (dump_file)
 	fprintf (dump_file, ";; loop %d uses iterator\n", loop->loop_no);
-      return false;
+      return hwloop_missed (loop, HWLOOP_USES_ITERATOR);
+    }
+
+  /* The iteration count given to lp.setup is then only an upper bound, leaving
+     the body with a regular branch is fine since LC/LS/LE are set again by the
+     setup of the next hw loop using the same level.  */
+  early_exits = riscv_loop_early_exits (loop);
+  if (early_exits)
+    {
+      if (TARGET_MASK_NOHWLOOPEXIT)
+	{
+	  if (dump_file)
+	    fprintf (dump_file, ";; loop %d has early exits\n", loop->loop_no);
+	  return hwloop_missed (loop, HWLOOP_EARLY_EXIT);
+	}
+      if (dump_file)
+	fprintf (dump_file, ";; loop %d has %d early exit(s), lp count is an upper bound\n", loop->loop_no, early_exits);
     }
 
   clobber0 = (TEST_HARD_REG_BIT (loop->regs_set_in_loop, REG_LC0)
@@ -6005,12 +8358,24 @@ hwloop_optimize (hwloop_info loop)
   clobber1 = (TEST_HARD_REG_BIT (loop->regs_set_in_loop, REG_LC1)
               || TEST_HARD_REG_BIT (loop->regs_set_in_loop, REG_LS1)
               || TEST_HARD_REG_BIT (loop->regs_set_in_loop, REG_LE1));
+  if ((clobber0 || clobber1) && riscv_loop_has_call (loop))
+    {
+      /* Calls clobber every loop register as far as dataflow is concerned,
+	 use what is known about the callees instead.  */
+      unsigned levels = riscv_hwloop_levels_set_in_loop (loop);
+
+      clobber0 = (levels & HWLOOP_LEVEL0) != 0;
+      clobber1 = (levels & HWLOOP_LEVEL1) != 0;
+      if (dump_file)
+	fprintf (dump_file, ";; loop %d contains calls, levels written in loop: %s%s\n",
+		 loop->loop_no, clobber0?"0 ":"", clobber1?"1":"");
+    }
   if (clobber0 && clobber1)
     {
       if (dump_file)
         fprintf (dump_file, ";; loop %d no loop reg available\n",
                  loop->loop_no);
-      return false;
+      return hwloop_missed (loop, HWLOOP_NO_LOOP_REG);
     }
 
   /* There should be an instruction before the loop_end instruction
@@ -6070,7 +8435,7 @@ hwloop_optimize (hwloop_info loop)
 
   if (!last_insn) {
       if (dump_file) fprintf (dump_file, ";; loop %d has no last instruction\n", loop->loop_no);
-      return false;
+      return hwloop_missed (loop, HWLOOP_NO_LAST_INSN);
     }
 
   if (dump_file) {
@@ -6103,7 +8468,7 @@ hwloop_optimize (hwloop_info loop)
 		}
       		if (loop->length + 1 > MAX_LOOP_LENGTH) {
 	  		if (dump_file) fprintf (dump_file, ";; loop %d too long\n", loop->loop_no);
-	  		return false;
+	  		return hwloop_missed (loop, HWLOOP_TOO_LONG);
 		} else loop->length += 1;
       		last_insn = emit_insn_after (gen_forced_nop (), last_insn);
 	}
@@ -6115,7 +8480,7 @@ hwloop_optimize (hwloop_info loop)
       if (dump_file)
 	fprintf (dump_file, ";; loop %d has bad last instruction\n",
 		 loop->loop_no);
-      return false;
+      return hwloop_missed (loop, HWLOOP_BAD_LAST_INSN);
     }
   /* In all other cases, try to replace a bad last insn with a nop.  */
   else if (JUMP_P (last_insn)
@@ -6125,7 +8490,7 @@ hwloop_optimize (hwloop_info loop)
 	   || asm_noperands (PATTERN (last_insn)) >= 0) {
       	if (loop->length + 1 > MAX_LOOP_LENGTH) {
 	  	if (dump_file) fprintf (dump_file, ";; loop %d too long\n", loop->loop_no);
-	  	return false;
+	  	return hwloop_missed (loop, HWLOOP_TOO_LONG);
 	} else loop->length += 1;
       	if (dump_file) {
 		fprintf (dump_file, ";; loop %d has bad last insn; replace with nop\n", loop->loop_no);
@@ -6169,6 +8534,9 @@ hwloop_optimize (hwloop_info loop)
 		le_reg = gen_rtx_REG (SImode, REG_LE0);
 		SET_HARD_REG_BIT (loop->regs_set_in_loop, REG_LC0);
 	}
+	if ((unsigned) loop->loop_no >= riscv_hwloop_loop_levels.length ())
+		riscv_hwloop_loop_levels.safe_grow_cleared (loop->loop_no + 1);
+	riscv_hwloop_loop_levels[loop->loop_no] = (loop_index == 1) ? HWLOOP_LEVEL1 : HWLOOP_LEVEL0;
 
 	{
 		df_ref *use_rec;
@@ -6425,6 +8793,7 @@ hwloop_optimize (hwloop_info loop)
      so we emit after and not before */
   emit_label_before (loop->end_label, loop->last_insn);
 
+  hwloop_record (loop, HWLOOP_OK, loop_index);
   return true;
 }
 
@@ -6495,7 +8864,11 @@ riscv_reorg_loops (void)
   df_chain_add_problem (DF_UD_CHAIN + DF_DU_CHAIN);
   df_analyze ();
 
+  riscv_hwloop_loop_levels.truncate (0);
+  riscv_select_hwloops ();
   reorg_loops (false, &riscv_doloop_hooks);
+  riscv_hwloop_loop_levels.release ();
+  if (riscv_hwloop_selected) BITMAP_FREE (riscv_hwloop_selected);
 
   df_live_add_problem ();
   df_live_set_all_dirty ();
@@ -6514,6 +8887,8 @@ riscv_reorg (void)
   /* Doloop optimization */
   if (cfun->machine->has_hardware_loops) riscv_reorg_loops ();
 
+  riscv_record_hwloop_levels ();
+
   df_finish_pass (false);
 }
 
@@ -6619,6 +8994,14 @@ static void riscv_file_end (void)
 	vec_free (import_symbols);
 	vec_free (export_symbols);
 
+	if (flag_verbose_asm) {
+		unsigned int created = riscv_hwloop_unit_counts[HWLOOP_OK], missed = 0;
+
+		for (i = HWLOOP_OK + 1; i < HWLOOP_STATUS_MAX; i++) missed += riscv_hwloop_unit_counts[i];
+		if (created + missed)
+			fprintf(asm_out_file, "\t%s hw loops: %u created, %u missed\n", ASM_COMMENT_START, created, missed);
+	}
+
 }
 
 
@@ -6647,6 +9030,9 @@ static void riscv_file_end (void)
 #undef TARGET_FUNCTION_OK_FOR_SIBCALL
 #define TARGET_FUNCTION_OK_FOR_SIBCALL riscv_function_ok_for_sibcall
 
+#undef TARGET_CALL_FUSAGE_CONTAINS_NON_CALLEE_CLOBBERS
+#define TARGET_CALL_FUSAGE_CONTAINS_NON_CALLEE_CLOBBERS true
+
 #undef TARGET_REGISTER_MOVE_COST
 #define TARGET_REGISTER_MOVE_COST riscv_register_move_cost
 #undef TARGET_MEMORY_MOVE_COST
@@ -6707,6 +9093,15 @@ static void riscv_file_end (void)
 #undef TARGET_SCALAR_MODE_SUPPORTED_P
 #define TARGET_SCALAR_MODE_SUPPORTED_P riscv_scalar_mode_supported_p
 
+#undef TARGET_PROMOTED_TYPE
+#define TARGET_PROMOTED_TYPE riscv_promoted_type
+
+#undef TARGET_CONVERT_TO_TYPE
+#define TARGET_CONVERT_TO_TYPE riscv_convert_to_type
+
+#undef TARGET_MANGLE_TYPE
+#define TARGET_MANGLE_TYPE riscv_mangle_type
+
 #undef TARGET_INIT_BUILTINS
 #define TARGET_INIT_BUILTINS riscv_init_builtins
 #undef TARGET_BUILTIN_DECL
@@ -6788,6 +9183,9 @@ static void riscv_file_end (void)
 #undef TARGET_VECTORIZE_PREFERRED_SIMD_MODE
 #define TARGET_VECTORIZE_PREFERRED_SIMD_MODE riscv_preferred_simd_mode
 
+#undef TARGET_VECTORIZE_AUTOVECTORIZE_VECTOR_SIZES
+#define TARGET_VECTORIZE_AUTOVECTORIZE_VECTOR_SIZES riscv_autovectorize_vector_sizes
+
 #undef TARGET_VECTORIZE_SUPPORT_VECTOR_MISALIGNMENT
 #define TARGET_VECTORIZE_SUPPORT_VECTOR_MISALIGNMENT riscv_builtin_support_vector_misalignment
 
@@ -6798,9 +9196,24 @@ static void riscv_file_end (void)
 #undef TARGET_VECTORIZE_BUILTIN_VECTORIZATION_COST
 #define TARGET_VECTORIZE_BUILTIN_VECTORIZATION_COST riscv_builtin_vectorization_cost
 
+#undef TARGET_VECTORIZE_INIT_COST
+#define TARGET_VECTORIZE_INIT_COST riscv_init_cost
+
+#undef TARGET_VECTORIZE_ADD_STMT_COST
+#define TARGET_VECTORIZE_ADD_STMT_COST riscv_add_stmt_cost
+
+#undef TARGET_VECTORIZE_FINISH_COST
+#define TARGET_VECTORIZE_FINISH_COST riscv_finish_cost
+
+#undef TARGET_VECTORIZE_DESTROY_COST_DATA
+#define TARGET_VECTORIZE_DESTROY_COST_DATA riscv_destroy_cost_data
+
 #undef TARGET_ASM_FILE_END
 #define TARGET_ASM_FILE_END riscv_file_end
 
+#undef TARGET_ASM_FUNCTION_EPILOGUE
+#define TARGET_ASM_FUNCTION_EPILOGUE riscv_output_function_epilogue
+
 #undef TARGET_ASM_GLOBALIZE_DECL_NAME
 #define TARGET_ASM_GLOBALIZE_DECL_NAME riscv_globalize_decl_name
 
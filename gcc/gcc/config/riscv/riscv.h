@@ -28,6 +28,11 @@ along with GCC; see the file COPYING3.  If not see
 #define TARGET_HARD_FLOAT TARGET_HARD_FLOAT_ABI
 #define TARGET_SOFT_FLOAT TARGET_SOFT_FLOAT_ABI
 
+/* TARGET_DOUBLE_FLOAT is true when DFmode values can live in FPRs.  With
+   an F-only FPU (TARGET_SINGLE_FLOAT) float uses the FPRs while double
+   is handled in software, unless double is mapped on float.  */
+#define TARGET_DOUBLE_FLOAT (TARGET_HARD_FLOAT && !TARGET_SINGLE_FLOAT)
+
 /* Target CPU builtins.  */
 #define TARGET_CPU_CPP_BUILTINS()					\
   do									\
@@ -67,6 +72,10 @@ along with GCC; see the file COPYING3.  If not see
 	 FPU is directly accessible.  */				\
       if (TARGET_HARD_FLOAT_ABI) {					\
 	builtin_define ("__riscv_hard_float");				\
+	if (TARGET_SINGLE_FLOAT)					\
+	  builtin_define ("__riscv_float_abi_single");			\
+	else								\
+	  builtin_define ("__riscv_float_abi_double");			\
 	if (TARGET_FDIV) {						\
 	  builtin_define ("__riscv_fdiv");				\
 	  builtin_define ("__riscv_fsqrt");				\
@@ -276,8 +285,8 @@ along with GCC; see the file COPYING3.  If not see
 #define MIN_UNITS_PER_WORD 4
 #endif
 
-/* We currently require both or neither of the `F' and `D' extensions. */
-#define UNITS_PER_FPREG 8
+/* FPRs are 32 bits wide when only the `F' extension is present.  */
+#define UNITS_PER_FPREG (TARGET_SINGLE_FLOAT ? 4 : 8)
 
 /* If FP regs aren't wide enough for a given FP argument, it is passed in
    integer registers. */
@@ -292,6 +301,7 @@ along with GCC; see the file COPYING3.  If not see
    registers.  */
 #define UNITS_PER_FPVALUE			\
   (TARGET_SOFT_FLOAT_ABI ? 0			\
+   : TARGET_SINGLE_FLOAT ? UNITS_PER_FPREG	\
    : LONG_DOUBLE_TYPE_SIZE / BITS_PER_UNIT)
 
 /* The number of bytes in a double.  */
@@ -1188,9 +1198,21 @@ while (0)
 
 #ifndef USED_FOR_TARGET
 
+/* Microarchitecture selected by -mtune, must match the "tune" attribute
+   of riscv.md.  */
+enum riscv_microarchitecture_type {
+  generic_rocket,
+  pulp_riscy,
+  pulp_zeroriscy,
+  pulp_microriscy,
+  pulp_pulpslim
+};
+
 extern const enum reg_class riscv_regno_to_class[];
 extern bool riscv_hard_regno_mode_ok[][FIRST_PSEUDO_REGISTER];
 extern const char* riscv_hi_relocs[];
+extern enum riscv_microarchitecture_type riscv_microarchitecture;
+extern const struct real_format riscv_fp8_format;
 #endif
 
 #define ASM_PREFERRED_EH_DATA_FORMAT(CODE,GLOBAL) \
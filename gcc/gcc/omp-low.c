@@ -4511,6 +4511,169 @@ oacc_lower_reduction_var_helper (gimple_seq *stmt_seqp, omp_context *ctx,
   stmt = gimplify_assign (x, new_var, stmt_seqp);
 }
 
+/* If Pulp native reductions, instead of serializing the merges through
+   GOMP_atomic_start we generate:
+
+			N = omp_get_num_threads ();
+			if (N > Slots) goto generic;
+			if (omp_get_level () != 1) goto generic;
+			Id = omp_get_thread_num ();			This is funct 2
+			Slot_x[Id] = x_private;				For every reduction
+			GOMP_barrier ();
+			if (Id == 0) {
+			  for (i = 1; i < N; i++) x_private = x_private OP Slot_x[i];
+			  x = x OP x_private;
+			}
+			goto end;
+		generic:
+			...						Generic lowering
+		end:
+
+      Slot_x is a static array with Slots entries, Slots is returned by the
+      target in Index. A team larger than that takes the generic path. The
+      slot array is one per construct, shared by every team that runs it, so
+      only the outermost team may use it: with nested parallelism several
+      inner teams would write the same slots. Constructs lexically inside
+      a second parallel region are rejected here, the level test catches
+      the ones called from a parallel region. Both tests give the same
+      answer to every thread of the team, so they all agree on the path
+      and on the barrier. Only constructs that are, or are directly nested
+      in, a parallel region are handled. Nowait constructs are left to
+      libgomp since a thread could overwrite its slot before thread 0 has
+      read it.
+      Returns the end label the generic lowering has to emit after its own
+      sequence, NULL_TREE if only the generic lowering has to be used.  */
+
+static tree
+lower_native_reduction_clauses (tree clauses, gimple_seq *stmt_seqp,
+				omp_context *ctx)
+{
+  gimple_seq store_seq = NULL, combine_seq = NULL, merge_seq = NULL;
+  tree c, x, id, nthreads, level, i, DeclFun;
+  tree lab_level, lab_native, lab_generic, lab_master, lab_body, lab_test;
+  tree lab_merge, lab_done, lab_end;
+  omp_context *up;
+  int Base, Slots;
+
+  if (find_omp_clause (clauses, OMP_CLAUSE_NOWAIT))
+    return NULL_TREE;
+  if (gimple_code (ctx->stmt) != GIMPLE_OMP_PARALLEL
+      && !(ctx->outer && gimple_code (ctx->outer->stmt) == GIMPLE_OMP_PARALLEL))
+    return NULL_TREE;
+  up = (gimple_code (ctx->stmt) == GIMPLE_OMP_PARALLEL) ? ctx->outer : ctx->outer->outer;
+  for (; up; up = up->outer)
+    if (gimple_code (up->stmt) == GIMPLE_OMP_PARALLEL)
+      return NULL_TREE;
+
+  for (c = clauses; c ; c = OMP_CLAUSE_CHAIN (c))
+    if (OMP_CLAUSE_CODE (c) == OMP_CLAUSE_REDUCTION)
+      {
+	tree type = TREE_TYPE (OMP_CLAUSE_DECL (c));
+
+	if (is_reference (OMP_CLAUSE_DECL (c)))
+	  type = TREE_TYPE (type);
+	if (!INTEGRAL_TYPE_P (type) && !SCALAR_FLOAT_TYPE_P (type))
+	  return NULL_TREE;
+      }
+
+  DeclFun = targetm.omp_target_decl (2, &Base, &Slots);
+  id = create_tmp_var (integer_type_node);
+  i = create_tmp_var (integer_type_node);
+
+  for (c = clauses; c ; c = OMP_CLAUSE_CHAIN (c))
+    {
+      tree var, ref, new_var, slot, type;
+      enum tree_code code;
+      location_t clause_loc = OMP_CLAUSE_LOCATION (c);
+
+      if (OMP_CLAUSE_CODE (c) != OMP_CLAUSE_REDUCTION)
+	continue;
+
+      var = OMP_CLAUSE_DECL (c);
+      new_var = lookup_decl (var, ctx);
+      if (is_reference (var))
+	new_var = build_simple_mem_ref_loc (clause_loc, new_var);
+      type = TREE_TYPE (new_var);
+      code = OMP_CLAUSE_REDUCTION_CODE (c);
+      if (code == MINUS_EXPR)
+	code = PLUS_EXPR;
+
+      slot = create_tmp_var_raw (build_array_type_nelts (type, Slots),
+				 "omp_red");
+      DECL_CONTEXT (slot) = NULL_TREE;
+      TREE_STATIC (slot) = 1;
+      TREE_ADDRESSABLE (slot) = 1;
+      DECL_ARTIFICIAL (slot) = 1;
+      DECL_IGNORED_P (slot) = 1;
+      varpool_node::finalize_decl (slot);
+
+      x = build4 (ARRAY_REF, type, slot, id, NULL_TREE, NULL_TREE);
+      gimplify_assign (x, unshare_expr (new_var), &store_seq);
+
+      x = build4 (ARRAY_REF, type, slot, i, NULL_TREE, NULL_TREE);
+      x = build2 (code, type, unshare_expr (new_var), x);
+      gimplify_assign (unshare_expr (new_var), x, &combine_seq);
+
+      ref = build_outer_var_ref (var, ctx);
+      x = build2 (code, TREE_TYPE (ref), ref, unshare_expr (new_var));
+      ref = build_outer_var_ref (var, ctx);
+      gimplify_assign (ref, x, &merge_seq);
+    }
+
+  lab_level = create_artificial_label (UNKNOWN_LOCATION);
+  lab_native = create_artificial_label (UNKNOWN_LOCATION);
+  lab_generic = create_artificial_label (UNKNOWN_LOCATION);
+  lab_master = create_artificial_label (UNKNOWN_LOCATION);
+  lab_body = create_artificial_label (UNKNOWN_LOCATION);
+  lab_test = create_artificial_label (UNKNOWN_LOCATION);
+  lab_merge = create_artificial_label (UNKNOWN_LOCATION);
+  lab_done = create_artificial_label (UNKNOWN_LOCATION);
+  lab_end = create_artificial_label (UNKNOWN_LOCATION);
+
+  nthreads = create_tmp_var (integer_type_node);
+  gimplify_assign (nthreads,
+		   build_call_expr (builtin_decl_explicit (BUILT_IN_OMP_GET_NUM_THREADS), 0),
+		   stmt_seqp);
+  gimple_seq_add_stmt (stmt_seqp,
+		       gimple_build_cond (GT_EXPR, nthreads,
+					  build_int_cst (integer_type_node, Slots),
+					  lab_generic, lab_level));
+  gimple_seq_add_stmt (stmt_seqp, gimple_build_label (lab_level));
+  level = create_tmp_var (integer_type_node);
+  x = build_fn_decl ("omp_get_level",
+		     build_function_type_list (integer_type_node, NULL_TREE));
+  gimplify_assign (level, build_call_expr (x, 0), stmt_seqp);
+  gimple_seq_add_stmt (stmt_seqp,
+		       gimple_build_cond (NE_EXPR, level, integer_one_node,
+					  lab_generic, lab_native));
+  gimple_seq_add_stmt (stmt_seqp, gimple_build_label (lab_native));
+  gimplify_assign (id, build_call_expr (DeclFun, 0), stmt_seqp);
+  gimple_seq_add_seq (stmt_seqp, store_seq);
+  gimple_seq_add_stmt (stmt_seqp,
+		       gimple_build_call (builtin_decl_explicit (BUILT_IN_GOMP_BARRIER), 0));
+  gimple_seq_add_stmt (stmt_seqp,
+		       gimple_build_cond (NE_EXPR, id, integer_zero_node,
+					  lab_done, lab_master));
+  gimple_seq_add_stmt (stmt_seqp, gimple_build_label (lab_master));
+  gimplify_assign (i, integer_one_node, stmt_seqp);
+  gimple_seq_add_stmt (stmt_seqp, gimple_build_goto (lab_test));
+  gimple_seq_add_stmt (stmt_seqp, gimple_build_label (lab_body));
+  gimple_seq_add_seq (stmt_seqp, combine_seq);
+  gimplify_assign (i, build2 (PLUS_EXPR, integer_type_node, i, integer_one_node),
+		   stmt_seqp);
+  gimple_seq_add_stmt (stmt_seqp, gimple_build_label (lab_test));
+  gimple_seq_add_stmt (stmt_seqp,
+		       gimple_build_cond (LT_EXPR, i, nthreads,
+					  lab_body, lab_merge));
+  gimple_seq_add_stmt (stmt_seqp, gimple_build_label (lab_merge));
+  gimple_seq_add_seq (stmt_seqp, merge_seq);
+  gimple_seq_add_stmt (stmt_seqp, gimple_build_label (lab_done));
+  gimple_seq_add_stmt (stmt_seqp, gimple_build_goto (lab_end));
+  gimple_seq_add_stmt (stmt_seqp, gimple_build_label (lab_generic));
+
+  return lab_end;
+}
+
 /* Generate code to implement the REDUCTION clauses.  */
 
 static void
@@ -4518,7 +4681,7 @@ lower_reduction_clauses (tree clauses, gimple_seq *stmt_seqp, omp_context *ctx)
 {
   gimple_seq sub_seq = NULL;
   gimple stmt;
-  tree x, c, tid = NULL_TREE;
+  tree x, c, tid = NULL_TREE, lab_native_end = NULL_TREE;
   int count = 0;
 
   /* SIMD reductions are handled in lower_rec_input_clauses.  */
@@ -4543,6 +4706,10 @@ lower_reduction_clauses (tree clauses, gimple_seq *stmt_seqp, omp_context *ctx)
   if (count == 0)
     return;
 
+  if (count > 0 && !is_gimple_omp_oacc (ctx->stmt)
+      && targetm.omp_target_decl (2, NULL, NULL))
+    lab_native_end = lower_native_reduction_clauses (clauses, stmt_seqp, ctx);
+
   /* Initialize thread info for OpenACC.  */
   if (is_gimple_omp_oacc (ctx->stmt))
     {
@@ -4590,6 +4757,8 @@ lower_reduction_clauses (tree clauses, gimple_seq *stmt_seqp, omp_context *ctx)
 	  x = fold_build2_loc (clause_loc, code, TREE_TYPE (ref), ref, new_var);
 	  x = build2 (OMP_ATOMIC, void_type_node, addr, x);
 	  gimplify_and_add (x, stmt_seqp);
+	  if (lab_native_end)
+	    gimple_seq_add_stmt (stmt_seqp, gimple_build_label (lab_native_end));
 	  return;
 	}
       else if (OMP_CLAUSE_REDUCTION_PLACEHOLDER (c))
@@ -4627,6 +4796,9 @@ lower_reduction_clauses (tree clauses, gimple_seq *stmt_seqp, omp_context *ctx)
   stmt = gimple_build_call (builtin_decl_explicit (BUILT_IN_GOMP_ATOMIC_END),
 			    0);
   gimple_seq_add_stmt (stmt_seqp, stmt);
+
+  if (lab_native_end)
+    gimple_seq_add_stmt (stmt_seqp, gimple_build_label (lab_native_end));
 }
 
 
@@ -6401,6 +6573,8 @@ expand_omp_for_generic (struct omp_region *region,
 
       Check if (fd->iter_type == integer_type_node), if not fall back to standard expansion
       else istart0 and iend0 are having integer_type_node and also our builtins return the same types
+      Ordered loops keep libgomp since GOMP_ordered_* rely on the work share state its
+      GOMP_loop_ordered_*_next maintain.
 	
       t = build_call_expr (targetm.omp_target_decl(0), 0);
       t = force_gimple_operand_gsi (&gsi, t, true, NULL_TREE, false, GSI_CONTINUE_LINKING);
@@ -6409,7 +6583,7 @@ expand_omp_for_generic (struct omp_region *region,
 	
 */
       if (!broken_loop &&
-	  !gimple_omp_for_combined_into_p (fd->for_stmt) &&
+	  !gimple_omp_for_combined_into_p (fd->for_stmt) && !fd->have_ordered &&
 	  (fd->iter_type == integer_type_node || fd->iter_type == long_integer_type_node)&&
 	  targetm.omp_target_decl(0, NULL, NULL) && targetm.omp_target_decl(1, NULL, NULL)) {
 	tree t1;
@@ -10500,6 +10674,19 @@ lower_omp_critical (gimple_stmt_iterator *gsi_p, omp_context *ctx)
 	  DECL_ARTIFICIAL (decl) = 1;
 	  DECL_IGNORED_P (decl) = 1;
 
+	  /* If Pulp native named critical sections, the lock is a hardware
+	     mutex of the event unit. The .evt_mutex section is mapped on the
+	     mutex registers by the link script, so each name gets its own
+	     mutex at link time and the same name in several units one. The
+	     target only offers it when that link script is used, the lock
+	     calls are remapped under the same condition.  */
+	  if (targetm.omp_target_decl (3, NULL, NULL))
+	    {
+	      DECL_COMMON (decl) = 0;
+	      set_decl_section_name (decl, ".evt_mutex");
+	      make_decl_one_only (decl, DECL_ASSEMBLER_NAME (decl));
+	    }
+
 	  varpool_node::finalize_decl (decl);
 
 	  critical_name_mutexes->put (name, decl);
@@ -0,0 +1,136 @@
+/* Soft conversions between float and the __fp16 and __fp8 storage types.
+
+   Copyright (C) 2017 Free Software Foundation, Inc.
+
+This file is part of GCC.
+
+GCC is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free
+Software Foundation; either version 3, or (at your option) any later
+version.
+
+GCC is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+for more details.
+
+Under Section 7 of GPL version 3, you are granted additional
+permissions described in the GCC Runtime Library Exception, version
+3.1, as published by the Free Software Foundation.
+
+You should have received a copy of the GNU General Public License and
+a copy of the GCC Runtime Library Exception along with this program;
+see the files COPYING3 and COPYING.RUNTIME respectively.  If not, see
+<http://www.gnu.org/licenses/>.  */
+
+/* __fp16 is an IEEE half and __fp8 its upper byte: both have a sign bit,
+   a 5 bit exponent biased by 15 and MBITS (10 or 2) mantissa bits.  They
+   are passed and returned in the low bits of a GPR, without extension,
+   so the bit patterns are handled as unsigned int.  */
+
+typedef union
+{
+  float f;
+  unsigned int i;
+} sf_bits;
+
+extern float __extendhfsf2 (unsigned int);
+extern unsigned int __truncsfhf2 (float);
+extern float __extendqfsf2 (unsigned int);
+extern unsigned int __truncsfqf2 (float);
+
+static inline float
+small_to_sf (unsigned int h, int mbits)
+{
+  unsigned int sign = (h >> (5 + mbits)) & 1;
+  unsigned int exp = (h >> mbits) & 0x1f;
+  unsigned int mant = h & ((1u << mbits) - 1);
+  sf_bits u;
+
+  if (exp == 0x1f)
+    u.i = 0x7f800000 | (mant << (23 - mbits));
+  else if (exp != 0)
+    u.i = ((exp + 112) << 23) | (mant << (23 - mbits));
+  else if (mant == 0)
+    u.i = 0;
+  else
+    {
+      /* Normalize a subnormal.  */
+      exp = 113;
+      while (!(mant & (1u << mbits)))
+	{
+	  mant <<= 1;
+	  exp--;
+	}
+      u.i = (exp << 23) | ((mant & ((1u << mbits) - 1)) << (23 - mbits));
+    }
+  u.i |= sign << 31;
+  return u.f;
+}
+
+/* Round to nearest even.  */
+
+static inline unsigned int
+sf_to_small (float f, int mbits)
+{
+  sf_bits u;
+  unsigned int sign, abs, inf, h, rem, mant;
+  int exp, drop;
+
+  u.f = f;
+  sign = (u.i >> 31) << (5 + mbits);
+  abs = u.i & 0x7fffffff;
+  inf = 0x1f << mbits;
+  exp = abs >> 23;
+  drop = 23 - mbits;
+
+  if (abs >= 0x7f800000)
+    return sign | inf | (abs > 0x7f800000 ? 1u << (mbits - 1) : 0);
+
+  if (exp >= 113)
+    {
+      /* Normal in the small format, rebias the exponent.  */
+      h = (abs - (112u << 23)) >> drop;
+      rem = abs & ((1u << drop) - 1);
+    }
+  else
+    {
+      /* Subnormal in the small format, or zero.  */
+      drop += 113 - exp;
+      if (drop > 25)
+	return sign;
+      mant = (abs & 0x7fffff) | 0x800000;
+      h = mant >> drop;
+      rem = mant & ((1u << drop) - 1);
+    }
+
+  if (rem > (1u << (drop - 1)) || (rem == (1u << (drop - 1)) && (h & 1)))
+    h++;
+  if (h > inf)
+    h = inf;
+  return sign | h;
+}
+
+float
+__extendhfsf2 (unsigned int h)
+{
+  return small_to_sf (h & 0xffff, 10);
+}
+
+unsigned int
+__truncsfhf2 (float f)
+{
+  return sf_to_small (f, 10);
+}
+
+float
+__extendqfsf2 (unsigned int q)
+{
+  return small_to_sf (q & 0xff, 2);
+}
+
+unsigned int
+__truncsfqf2 (float f)
+{
+  return sf_to_small (f, 2);
+}